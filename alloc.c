@@ -0,0 +1,109 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * $Id$
+ */
+
+# ifdef HAVE_CONFIG_H
+#  include "config.h"
+# endif
+
+# include "global.h"
+
+# include <stdlib.h>
+# include <string.h>
+
+# include "stream.h"
+# include "alloc.h"
+
+/*
+ * Dynamic decoder buffers (Layer III main_data and overlap, and the
+ * contiguous block behind a struct mad_state) are obtained here. Each
+ * block is aligned to MAD_ALLOC_ALIGN and preceded by a small record of
+ * the allocator that produced it, so it can be released correctly by
+ * whichever finish routine ends up owning it.
+ */
+
+struct block {
+  struct mad_allocator const *allocator;
+  void *base;
+};
+
+static
+struct mad_allocator const *global_allocator = 0;
+
+/*
+ * NAME:	allocator->set()
+ * DESCRIPTION:	select the default allocator for dynamic decoder buffers
+ */
+void mad_allocator_set(struct mad_allocator const *allocator)
+{
+  global_allocator = allocator;
+}
+
+/*
+ * NAME:	alloc()
+ * DESCRIPTION:	allocate an aligned buffer, or return 0
+ */
+void *mad_alloc(struct mad_allocator const *allocator, unsigned long size)
+{
+  struct block *block;
+  unsigned char *base, *ptr;
+
+  if (allocator == 0)
+    allocator = global_allocator;
+
+  size += sizeof(*block) + MAD_ALLOC_ALIGN - 1;
+
+  if (allocator)
+    base = allocator->alloc(allocator->data, size);
+  else
+    base = malloc(size);
+
+  if (base == 0)
+    return 0;
+
+  ptr  = base + sizeof(*block);
+  ptr += (MAD_ALLOC_ALIGN - (size_t) ptr % MAD_ALLOC_ALIGN) % MAD_ALLOC_ALIGN;
+
+  block = (struct block *) ptr - 1;
+
+  block->allocator = allocator;
+  block->base      = base;
+
+  return ptr;
+}
+
+/*
+ * NAME:	free()
+ * DESCRIPTION:	release a buffer obtained from mad_alloc()
+ */
+void mad_free(void *ptr)
+{
+  struct block *block;
+
+  if (ptr == 0)
+    return;
+
+  block = (struct block *) ptr - 1;
+
+  if (block->allocator)
+    block->allocator->free(block->allocator->data, block->base);
+  else
+    free(block->base);
+}
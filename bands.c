@@ -0,0 +1,89 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * $Id$
+ */
+
+# ifdef HAVE_CONFIG_H
+#  include "config.h"
+# endif
+
+# include "global.h"
+
+# include "fixed.h"
+# include "frame.h"
+# include "bands.h"
+# include "layer3.h"
+
+/*
+ * Band energies describe a frame for analysis (loudness, spectra, silence
+ * detection, fingerprinting) without synthesizing any PCM. Each is the mean
+ * square of one of the 32 subbands of one channel over one granule: the
+ * single block of 12 subband samples of a Layer I frame, each of the three
+ * of a Layer II frame, or each Layer III granule of 18.
+ *
+ * A Layer III frame decoded with a deferred back end (see batch.c) has no
+ * subband samples yet; its energies are then taken from the requantized
+ * spectrum instead, skipping alias reduction and the IMDCT as well. These
+ * are scaled by the gain of the IMDCT to match the subband energies over
+ * a run of granules, but not within each one (see mad_layer_III_bands()).
+ */
+
+/*
+ * NAME:	bands->frame()
+ * DESCRIPTION:	compute the subband energies of a decoded frame
+ */
+void mad_bands_frame(struct mad_bands *bands, struct mad_frame const *frame)
+{
+  struct mad_header const *header = &frame->header;
+  unsigned int ns, gr, ch, sb, s;
+  mad_fixed_t const *sample;
+  mad_fixed_t scale, sum;
+
+  bands->channels = MAD_NCHANNELS(header);
+
+  if (header->layer == MAD_LAYER_III && frame->backend) {
+    bands->granules = mad_layer_III_bands(frame, bands->energy);
+    bands->length   = 576;
+
+    return;
+  }
+
+  ns = (header->layer == MAD_LAYER_III) ? 18 : 12;
+
+  bands->granules = MAD_NSBSAMPLES(header) / ns;
+  bands->length   = 32 * ns;
+
+  /* each square is scaled as it is summed, so the sum cannot overflow */
+
+  scale = MAD_F_ONE / ns;
+
+  for (gr = 0; gr < bands->granules; ++gr) {
+    for (ch = 0; ch < bands->channels; ++ch) {
+      for (sb = 0; sb < 32; ++sb) {
+	sample = &frame->sbsample[ch][ns * gr][sb];
+	sum    = 0;
+
+	for (s = 0; s < ns; ++s, sample += 32)
+	  sum += mad_f_mul(*sample, mad_f_mul(*sample, scale));
+
+	bands->energy[gr][ch][sb] = sum;
+      }
+    }
+  }
+}
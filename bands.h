@@ -0,0 +1,38 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * $Id$
+ */
+
+
+# ifndef LIBMAD_BANDS_H
+# define LIBMAD_BANDS_H
+
+# include "fixed.h"
+# include "frame.h"
+
+struct mad_bands {
+  unsigned short granules;		/* number of granules */
+  unsigned short channels;		/* number of channels */
+  unsigned short length;		/* samples per channel per granule */
+  mad_fixed_t energy[3][2][32];		/* mean square [gr][ch][sb] */
+};
+
+void mad_bands_frame(struct mad_bands *, struct mad_frame const *);
+
+# endif
@@ -0,0 +1,171 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * $Id$
+ */
+
+
+# ifdef HAVE_CONFIG_H
+#  include "config.h"
+# endif
+
+# include "global.h"
+
+# include "fixed.h"
+# include "stream.h"
+# include "frame.h"
+# include "synth.h"
+# include "batch.h"
+# include "layer3.h"
+# include "alloc.h"
+
+/*
+ * Batched decoding runs each stage over several frames before moving on to
+ * the next: first the front end of every frame (header, side information,
+ * Huffman decoding, requantization and joint stereo, or the whole of Layer
+ * I and II), then the Layer III back end (alias reduction, IMDCT and
+ * overlap-add) of every frame, and finally the subband synthesis of every
+ * frame. The code and tables of each stage thus stay in the caches across
+ * frames instead of being evicted by the other stages of the same frame.
+ *
+ * The frames of a batch borrow the overlap buffer and worker thread of the
+ * caller's frame, so batched and single-frame decoding may be mixed freely
+ * on the same stream, frame, and synth.
+ */
+
+/*
+ * NAME:	batch->init()
+ * DESCRIPTION:	initialize a batch struct
+ */
+void mad_batch_init(struct mad_batch *batch)
+{
+  batch->size   = 0;
+  batch->frames = 0;
+}
+
+/*
+ * NAME:	batch->finish()
+ * DESCRIPTION:	deallocate any dynamic memory associated with batch
+ */
+void mad_batch_finish(struct mad_batch *batch)
+{
+  unsigned int i;
+
+  for (i = 0; i < batch->size; ++i)
+    mad_frame_finish(&batch->frames[i]);
+
+  mad_free(batch->frames);
+
+  batch->size   = 0;
+  batch->frames = 0;
+}
+
+/*
+ * NAME:	batch_alloc()
+ * DESCRIPTION:	allocate frames, each deferring its Layer III back end
+ */
+static
+int batch_alloc(struct mad_batch *batch,
+		struct mad_allocator const *allocator, unsigned int count)
+{
+  mad_batch_finish(batch);
+
+  batch->frames = mad_alloc(allocator, count * sizeof(*batch->frames));
+  if (batch->frames == 0)
+    return -1;
+
+  for (batch->size = 0; batch->size < count; ++batch->size) {
+    struct mad_frame *frame = &batch->frames[batch->size];
+
+    mad_frame_init(frame);
+
+    frame->backend = mad_layer_III_defer(allocator);
+    if (frame->backend == 0) {
+      ++batch->size;
+      mad_batch_finish(batch);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * NAME:	batch->decode()
+ * DESCRIPTION:	decode and synthesize up to count frames into pcm[]; return
+ *		the number of frames decoded
+ */
+unsigned int mad_batch_decode(struct mad_batch *batch,
+			      struct mad_stream *stream,
+			      struct mad_frame *frame, struct mad_synth *synth,
+			      struct mad_pcm *pcm, unsigned int count)
+{
+  unsigned int n, i;
+
+  stream->error = MAD_ERROR_NONE;
+
+  if (count > batch->size &&
+      batch_alloc(batch, stream->allocator, count) == -1) {
+    stream->error = MAD_ERROR_NOMEM;
+    return 0;
+  }
+
+  /*
+   * Decoding stops at the first frame that fails; it is skipped (or left
+   * in the stream) just as by mad_frame_decode(), and stream->error tells
+   * why fewer than count frames were returned.
+   */
+
+  for (n = 0; n < count; ++n) {
+    struct mad_frame *batched = &batch->frames[n];
+    int result;
+
+    batched->overlap = frame->overlap;
+    batched->pool    = frame->pool;
+    batched->gain    = frame->gain;
+
+    result = mad_frame_decode(batched, stream);
+
+    /* the first Layer III frame may have allocated these */
+
+    frame->overlap = batched->overlap;
+    frame->pool    = batched->pool;
+
+    if (result == -1)
+      break;
+  }
+
+  for (i = 0; i < n; ++i) {
+    if (batch->frames[i].header.layer == MAD_LAYER_III)
+      mad_layer_III_backend(&batch->frames[i], stream->stats);
+  }
+
+  mad_synth_frames(synth, batch->frames, n, pcm);
+
+  for (i = 0; i <= n && i < count; ++i) {
+    batch->frames[i].overlap = 0;
+    batch->frames[i].pool    = 0;
+  }
+
+  if (n > 0) {
+    frame->header  = batch->frames[n - 1].header;
+    frame->options = batch->frames[n - 1].options;
+  }
+
+  return n;
+}
@@ -0,0 +1,42 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * $Id$
+ */
+
+
+# ifndef LIBMAD_BATCH_H
+# define LIBMAD_BATCH_H
+
+# include "stream.h"
+# include "frame.h"
+# include "synth.h"
+
+struct mad_batch {
+  unsigned int size;			/* number of frames allocated */
+  struct mad_frame *frames;		/* frames decoded together */
+};
+
+void mad_batch_init(struct mad_batch *);
+void mad_batch_finish(struct mad_batch *);
+
+unsigned int mad_batch_decode(struct mad_batch *, struct mad_stream *,
+			      struct mad_frame *, struct mad_synth *,
+			      struct mad_pcm *, unsigned int);
+
+# endif
@@ -0,0 +1,401 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * $Id$
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <sys/time.h>
+
+# include "mad.h"
+# include "corpus.h"
+
+/*
+ * This is the libmad decoding benchmark. A corpus of bitstreams covering
+ * Layers I, II, and III, MPEG-1, MPEG-2 LSF, and MPEG 2.5, CBR and VBR,
+ * single channel, stereo, and joint stereo, short blocks, free format, and
+ * CRC protection is synthesized in memory (see corpus.c), so the results
+ * are reproducible and no sample files are needed. Each bitstream is then
+ * decoded with the high-level API (or, with -b, with mad_batch_decode() in
+ * batches of the given number of frames, or, with -w, into waveform peaks
+ * of the given number of samples with mad_synth_peaks() at quarter rate),
+ * and the results are written to standard output as JSON. If the library
+ * was configured with --enable-stats, the time spent in each decoding stage
+ * is reported as well.
+ *
+ * Usage: mad-bench [-n iterations] [-s seconds] [-t] [-g] [-b frames]
+ *                  [-w samples] [case ...]
+ */
+
+static
+char const *const stage_names[MAD_NSTAGES] = {
+  "header", "crc", "sideinfo", "scalefactors", "huffman", "requantize",
+  "stereo", "alias", "imdct", "synth", "output"
+};
+
+struct bench {
+  unsigned char const *data;
+  unsigned long length;
+  unsigned char const *guard;
+
+  unsigned long frames;
+  unsigned long samples;
+  unsigned long errors;
+
+  unsigned int partial;			/* samples output of the frame so far */
+};
+
+/*
+ * NAME:	now()
+ * DESCRIPTION:	return the wall clock time in seconds
+ */
+static
+double now(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, 0);
+
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static
+enum mad_flow input(void *data, struct mad_stream *stream)
+{
+  struct bench *bench = data;
+
+  if (bench->length == 0)
+    return MAD_FLOW_STOP;
+
+  mad_stream_buffer(stream, bench->data, bench->length);
+  bench->length = 0;
+
+  return MAD_FLOW_CONTINUE;
+}
+
+static
+enum mad_flow output(void *data,
+		     struct mad_header const *header, struct mad_pcm *pcm)
+{
+  struct bench *bench = data;
+
+  bench->samples += pcm->length;
+
+  /* with -g, Layer III frames are output a granule at a time */
+
+  bench->partial += pcm->length;
+  if (bench->partial >= 32 * MAD_NSBSAMPLES(header)) {
+    ++bench->frames;
+    bench->partial = 0;
+  }
+
+  return MAD_FLOW_CONTINUE;
+}
+
+static
+enum mad_flow error(void *data,
+		    struct mad_stream *stream, struct mad_frame *frame)
+{
+  struct bench *bench = data;
+
+  /* the zeroed guard after the last frame is not a decoding error */
+
+  if (stream->this_frame < bench->guard)
+    ++bench->errors;
+
+  return MAD_FLOW_CONTINUE;
+}
+
+/*
+ * NAME:	run()
+ * DESCRIPTION:	decode a bitstream once; return elapsed seconds
+ */
+static
+double run(struct bench *bench, unsigned char const *data,
+	   unsigned long length, int options, struct mad_stats *stats,
+	   int *have_stats)
+{
+  struct mad_decoder decoder;
+  struct mad_stats run_stats;
+  double start, elapsed;
+  int i;
+
+  bench->data   = data;
+  bench->length = length;
+  bench->guard  = data + length - MAD_BUFFER_GUARD;
+
+  mad_decoder_init(&decoder, bench, input, 0 /* header */, 0 /* filter */,
+		   output, error, 0 /* message */);
+  mad_decoder_options(&decoder, options);
+
+  start = now();
+  mad_decoder_run(&decoder, MAD_DECODER_MODE_SYNC);
+  elapsed = now() - start;
+
+  *have_stats = mad_decoder_stats(&decoder, &run_stats) == 0;
+  for (i = 0; i < MAD_NSTAGES; ++i)
+    stats->nsec[i] += run_stats.nsec[i];
+
+  mad_decoder_finish(&decoder);
+
+  return elapsed;
+}
+
+/*
+ * NAME:	run_batch()
+ * DESCRIPTION:	decode a bitstream once in batches; return elapsed seconds
+ */
+static
+double run_batch(struct bench *bench, unsigned char const *data,
+		 unsigned long length, int options, unsigned int frames)
+{
+  struct mad_stream stream;
+  struct mad_frame frame;
+  struct mad_synth synth;
+  struct mad_batch batch;
+  struct mad_pcm *pcm;
+  double start, elapsed;
+  unsigned int n, i;
+
+  pcm = malloc(frames * sizeof(*pcm));
+  if (pcm == 0)
+    return 0;
+
+  bench->guard = data + length - MAD_BUFFER_GUARD;
+
+  mad_stream_init(&stream);
+  mad_frame_init(&frame);
+  mad_synth_init(&synth);
+  mad_batch_init(&batch);
+
+  mad_stream_options(&stream, options);
+  mad_stream_buffer(&stream, data, length);
+
+  start = now();
+
+  do {
+    n = mad_batch_decode(&batch, &stream, &frame, &synth, pcm, frames);
+
+    for (i = 0; i < n; ++i) {
+      ++bench->frames;
+      bench->samples += pcm[i].length;
+    }
+
+    if (stream.error && MAD_RECOVERABLE(stream.error) &&
+	stream.this_frame < bench->guard)
+      ++bench->errors;
+  }
+  while (n == frames || MAD_RECOVERABLE(stream.error));
+
+  elapsed = now() - start;
+
+  mad_batch_finish(&batch);
+  mad_synth_finish(&synth);
+  mad_frame_finish(&frame);
+  mad_stream_finish(&stream);
+
+  free(pcm);
+
+  return elapsed;
+}
+
+/*
+ * NAME:	run_peaks()
+ * DESCRIPTION:	decode a bitstream once into peaks; return elapsed seconds
+ */
+static
+double run_peaks(struct bench *bench, unsigned char const *data,
+		 unsigned long length, int options, unsigned int samples)
+{
+  struct mad_stream stream;
+  struct mad_frame frame;
+  struct mad_synth synth;
+  struct mad_peaks peaks;
+  struct mad_peak (*bucket)[2];
+  unsigned int size;
+  double start, elapsed;
+
+  size   = 1152 / samples + 1;
+  bucket = malloc(size * sizeof(*bucket));
+  if (bucket == 0)
+    return 0;
+
+  bench->guard = data + length - MAD_BUFFER_GUARD;
+
+  mad_stream_init(&stream);
+  mad_frame_init(&frame);
+  mad_synth_init(&synth);
+  mad_peaks_init(&peaks, samples, 4, bucket, size);
+
+  mad_stream_options(&stream, options);
+  mad_stream_buffer(&stream, data, length);
+
+  start = now();
+
+  while (1) {
+    if (mad_frame_decode(&frame, &stream) == -1) {
+      if (!MAD_RECOVERABLE(stream.error))
+	break;
+
+      if (stream.this_frame < bench->guard)
+	++bench->errors;
+
+      continue;
+    }
+
+    mad_synth_peaks(&synth, &frame, &peaks);
+
+    ++bench->frames;
+    bench->samples += 32 * MAD_NSBSAMPLES(&frame.header);
+
+    peaks.count = 0;
+  }
+
+  elapsed = now() - start;
+
+  mad_synth_finish(&synth);
+  mad_frame_finish(&frame);
+  mad_stream_finish(&stream);
+
+  free(bucket);
+
+  return elapsed;
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned int iterations = 3, batch = 0, peaks = 0, c, i, n;
+  double seconds = 30;
+  int options = 0, first = 1, arg;
+
+  for (arg = 1; arg < argc && argv[arg][0] == '-'; ++arg) {
+    if (strcmp(argv[arg], "-n") == 0 && arg + 1 < argc)
+      iterations = atoi(argv[++arg]);
+    else if (strcmp(argv[arg], "-s") == 0 && arg + 1 < argc)
+      seconds = atof(argv[++arg]);
+    else if (strcmp(argv[arg], "-t") == 0)
+      options |= MAD_OPTION_THREADED;
+    else if (strcmp(argv[arg], "-g") == 0)
+      options |= MAD_OPTION_GRANULES;
+    else if (strcmp(argv[arg], "-b") == 0 && arg + 1 < argc)
+      batch = atoi(argv[++arg]);
+    else if (strcmp(argv[arg], "-w") == 0 && arg + 1 < argc)
+      peaks = atoi(argv[++arg]);
+    else {
+      fprintf(stderr, "usage: %s [-n iterations] [-s seconds] [-t] [-g] "
+	      "[-b frames] [-w samples] [case ...]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (iterations == 0 || seconds <= 0)
+    return 1;
+
+  printf("{\n");
+  printf("  \"version\": \"%s\",\n", MAD_VERSION);
+  printf("  \"build\": \"%s\",\n", mad_build);
+  printf("  \"iterations\": %u,\n", iterations);
+  printf("  \"threaded\": %s,\n", (options & MAD_OPTION_THREADED) ?
+	 "true" : "false");
+  printf("  \"granules\": %s,\n", (options & MAD_OPTION_GRANULES) ?
+	 "true" : "false");
+  printf("  \"batch\": %u,\n", batch);
+  printf("  \"peaks\": %u,\n", peaks);
+  printf("  \"cases\": [");
+
+  for (c = 0; c < corpus_size; ++c) {
+    struct corpus_case const *tc = &corpus[c];
+    struct bench bench;
+    struct mad_stats stats;
+    unsigned char *data;
+    unsigned long length;
+    double elapsed, audio;
+    int have_stats = 0;
+
+    if (arg < argc) {
+      for (i = arg; i < (unsigned int) argc; ++i) {
+	if (strcmp(argv[i], tc->name) == 0)
+	  break;
+      }
+      if (i == (unsigned int) argc)
+	continue;
+    }
+
+    length = corpus_synthesize(tc, seconds, &data);
+    if (length == 0) {
+      fprintf(stderr, "%s: not enough memory\n", argv[0]);
+      return 2;
+    }
+
+    memset(&bench, 0, sizeof(bench));
+    memset(&stats, 0, sizeof(stats));
+
+    elapsed = 0;
+    for (n = 0; n < iterations; ++n) {
+      if (peaks)
+	elapsed += run_peaks(&bench, data, length, options, peaks);
+      else if (batch)
+	elapsed += run_batch(&bench, data, length, options, batch);
+      else
+	elapsed += run(&bench, data, length, options, &stats, &have_stats);
+    }
+
+    free(data);
+
+    audio = (double) bench.samples / tc->samplerate;
+
+    printf("%s\n    {\n", first ? "" : ",");
+    first = 0;
+
+    printf("      \"name\": \"%s\",\n", tc->name);
+    printf("      \"layer\": %u,\n", tc->layer);
+    printf("      \"samplerate\": %u,\n", tc->samplerate);
+    printf("      \"bitrate\": %u,\n", tc->bitrate);
+    printf("      \"channels\": %u,\n",
+	   (tc->mode == MAD_MODE_SINGLE_CHANNEL) ? 1 : 2);
+    printf("      \"bytes\": %lu,\n", length);
+    printf("      \"frames\": %lu,\n", bench.frames);
+    printf("      \"errors\": %lu,\n", bench.errors);
+    printf("      \"audio_seconds\": %.3f,\n", audio);
+    printf("      \"seconds\": %.6f,\n", elapsed);
+    printf("      \"frames_per_sec\": %.1f,\n",
+	   elapsed > 0 ? bench.frames / elapsed : 0);
+    printf("      \"realtime\": %.1f,\n", elapsed > 0 ? audio / elapsed : 0);
+    printf("      \"ns_per_frame\": %.1f,\n",
+	   bench.frames ? elapsed * 1e9 / bench.frames : 0);
+
+    if (have_stats && bench.frames) {
+      printf("      \"stage_ns_per_frame\": {");
+      for (i = 0; i < MAD_NSTAGES; ++i) {
+	printf("%s\n        \"%s\": %.1f", i ? "," : "", stage_names[i],
+	       (double) stats.nsec[i] / bench.frames);
+      }
+      printf("\n      }\n");
+    }
+    else
+      printf("      \"stage_ns_per_frame\": null\n");
+
+    printf("    }");
+  }
+
+  printf("\n  ]\n}\n");
+
+  return 0;
+}
@@ -0,0 +1,715 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * $Id$
+ */
+
+/*
+ * This is the libmad conformance and accuracy harness. Like the kernel
+ * microbenchmarks, it includes the library sources directly, and `make
+ * conform' compiles it once for each decoder variant to be checked.
+ *
+ * One build, the reference, decodes the benchmark corpus (see corpus.c) and
+ * writes its output with -w; `make conform' uses FPM_FLOAT for it, so that
+ * the reference is computed in double precision. Every other build decodes
+ * the same corpus and compares its output against that file with -r,
+ * reporting the RMS and the maximum absolute error of each case relative to
+ * full scale, and the ISO/IEC 11172-4 accuracy class those errors meet:
+ *
+ *   full	RMS error < 2^-15 / sqrt(12) and maximum error <= 2^-14
+ *   limited	RMS error < 2^-11 / sqrt(12)
+ *   none	anything worse
+ *
+ * The standard applies these limits to its own test sequences; here they
+ * are applied to each synthesized case. The corpus is attenuated by 60 dB
+ * by default (-a) so that its pseudo-random content does not clip, and
+ * output samples are clipped to full scale before comparison, as they would
+ * be for any PCM output.
+ *
+ * Accuracy alone cannot tell whether a change altered the output of a
+ * fixed-point build, since the reference is computed by the same tree. Each
+ * case's raw output is therefore also hashed (32-bit FNV-1a over every
+ * sample as it leaves the synthesis filter, before clipping). With -g and
+ * the default -s and -a, the hashes are compared with those listed for the
+ * named variant in a golden file; `make conform' uses conform.sum, which
+ * holds the hashes of the original libmad 0.15.1b decoder.
+ *
+ * For Layer III cases, the band energies that mad_bands_frame() takes from
+ * the requantized spectrum of a deferred frame are also checked against
+ * those it computes from the same frame's subband samples once the back end
+ * has run. Their totals over each case must agree within BANDS_TOLERANCE
+ * dB; they are not expected to agree exactly, since the corpus switches
+ * block types at random and so does not meet the overlap-add conditions
+ * under which the IMDCT preserves energy from one granule to the next.
+ *
+ * Subband gains are checked by decoding each case again with a uniform
+ * gain of 1/2 and of MAD_GAIN_MAX. The PCM must match the ungained output
+ * times the gain to limited accuracy (the gain scales any error of the
+ * ungained output as well) unless -c none is given, and the subband samples
+ * must match the ungained ones times the gain, saturated at MAD_GAIN_CEIL,
+ * to within GAIN_TOLERANCE. The latter is also checked for a copy of the
+ * case with no attenuation, whose subband samples the maximum gain drives
+ * past the fixed-point range.
+ *
+ * The results are written to standard output as JSON. The exit status is 3
+ * if any case has decoding errors, fails to meet the class given with -c
+ * (default: limited; "none" only reports), differs from its golden hash,
+ * has Layer III band energies that disagree, or fails the gain checks.
+ *
+ * Usage: mad-conform-VARIANT [-s seconds] [-a dB] -w file
+ *        mad-conform-VARIANT [-s seconds] [-a dB] [-c class]
+ *                            [-g file variant] -r file
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <math.h>
+
+# include "version.c"
+# include "fixed.c"
+# include "bit.c"
+# include "timer.c"
+# include "stream.c"
+# include "frame.c"
+# include "layer12.c"
+# include "layer3.c"
+# include "huffman.c"
+# include "pool.c"
+# include "alloc.c"
+# include "stats.c"
+# include "gain.c"
+# include "bands.c"
+
+/* synth.c redefines MAD_F_SCALEBITS for its own use, so it must come last */
+# include "synth.c"
+
+# include "corpus.h"
+
+enum class {
+  CLASS_NONE,
+  CLASS_LIMITED,
+  CLASS_FULL
+};
+
+static
+char const *const class_names[] = { "none", "limited", "full" };
+
+struct result {
+  unsigned long samples;
+  unsigned long errors;
+
+  double sum2;
+  double max;
+
+  unsigned long hash;			/* FNV-1a hash of the raw output */
+};
+
+# define GOLDEN_MAX	256
+
+# define BANDS_TOLERANCE	3.0
+
+# define GAIN_TOLERANCE		(1.0 / 256)
+
+struct gain_result {
+  double rms;				/* RMS PCM error (full scale = 1) */
+  double max;				/* maximum subband sample error */
+};
+
+struct golden {
+  char variant[32];
+  char name[32];
+  unsigned long hash;
+};
+
+/*
+ * NAME:	sample()
+ * DESCRIPTION:	convert an output sample to double, clipped to full scale
+ */
+static
+double sample(mad_fixed_t value)
+{
+  double x = mad_f_todouble(value);
+
+  return (x > 1) ? 1 : (x < -1) ? -1 : x;
+}
+
+/*
+ * NAME:	hash()
+ * DESCRIPTION:	add the 32-bit two's complement form of a sample to a hash
+ */
+static
+unsigned long hash(unsigned long hash, mad_fixed_t value)
+{
+  unsigned long word;
+  unsigned int i;
+
+# if defined(FPM_FLOAT)
+  word = (unsigned long) (signed long)
+    floor(value * (1L << MAD_F_FRACBITS) + 0.5);
+# else
+  word = (unsigned long) value;
+# endif
+
+  for (i = 0; i < 32; i += 8) {
+    hash ^= (word >> i) & 0xff;
+    hash  = (hash * 16777619UL) & 0xffffffffUL;
+  }
+
+  return hash;
+}
+
+/*
+ * NAME:	golden_load()
+ * DESCRIPTION:	read the golden hashes of one variant; return their number,
+ *		or -1 on error
+ */
+static
+int golden_load(char const *path, char const *variant,
+		struct golden golden[GOLDEN_MAX])
+{
+  FILE *file;
+  char line[128];
+  int count = 0;
+
+  file = fopen(path, "r");
+  if (file == 0)
+    return -1;
+
+  while (fgets(line, sizeof(line), file)) {
+    struct golden *entry = &golden[count];
+
+    if (line[0] == '#' || line[0] == '\n')
+      continue;
+
+    if (sscanf(line, "%31s %31s %lx",
+	       entry->variant, entry->name, &entry->hash) != 3) {
+      count = -1;
+      break;
+    }
+
+    if (strcmp(entry->variant, variant) == 0 && ++count == GOLDEN_MAX)
+      break;
+  }
+
+  fclose(file);
+
+  return count;
+}
+
+/*
+ * NAME:	decode()
+ * DESCRIPTION:	decode a bitstream, writing or comparing its output
+ */
+static
+int decode(unsigned char const *data, unsigned long length,
+	   FILE *file, int writing, struct result *result)
+{
+  struct mad_stream stream;
+  struct mad_frame frame;
+  struct mad_synth synth;
+  unsigned char const *guard;
+  unsigned int count;
+  int status = 0;
+
+  memset(result, 0, sizeof(*result));
+
+  result->hash = 2166136261UL;
+
+  mad_stream_init(&stream);
+  mad_frame_init(&frame);
+  mad_synth_init(&synth);
+
+  guard = data + length - MAD_BUFFER_GUARD;
+  mad_stream_buffer(&stream, data, length);
+
+  /*
+   * Each frame's output is stored as its sample count followed by both
+   * channels of every sample; a zero count ends the bitstream.
+   */
+
+  while (1) {
+    struct mad_pcm *pcm = &synth.pcm;
+    double out[1152 * 2], ref[1152 * 2];
+    unsigned int ch, s;
+
+    if (mad_frame_decode(&frame, &stream) == -1) {
+      if (stream.error == MAD_ERROR_BUFLEN)
+	break;
+      if (stream.this_frame < guard)
+	++result->errors;
+      if (!MAD_RECOVERABLE(stream.error))
+	break;
+      continue;
+    }
+
+    mad_synth_frame(&synth, &frame);
+
+    count = pcm->length;
+    for (s = 0; s < count; ++s) {
+      for (ch = 0; ch < pcm->channels; ++ch)
+	result->hash = hash(result->hash, pcm->samples[ch][s]);
+
+      for (ch = 0; ch < 2; ++ch)
+	out[s * 2 + ch] = sample(pcm->samples[ch % pcm->channels][s]);
+    }
+
+    if (writing) {
+      if (fwrite(&count, sizeof(count), 1, file) != 1 ||
+	  fwrite(out, sizeof(out[0]), count * 2, file) != count * 2) {
+	status = -1;
+	break;
+      }
+    }
+    else {
+      unsigned int refcount;
+
+      if (fread(&refcount, sizeof(refcount), 1, file) != 1 ||
+	  refcount != count ||
+	  fread(ref, sizeof(ref[0]), count * 2, file) != count * 2) {
+	status = -1;
+	break;
+      }
+
+      for (s = 0; s < count * 2; ++s) {
+	double diff = fabs(out[s] - ref[s]);
+
+	result->sum2 += diff * diff;
+	if (diff > result->max)
+	  result->max = diff;
+      }
+    }
+
+    result->samples += count * 2;
+  }
+
+  if (status == 0) {
+    count = 0;
+
+    if (writing)
+      status = fwrite(&count, sizeof(count), 1, file) == 1 ? 0 : -1;
+    else {
+      status = (fread(&count, sizeof(count), 1, file) == 1 &&
+		count == 0) ? 0 : -1;
+    }
+  }
+
+  mad_synth_finish(&synth);
+  mad_frame_finish(&frame);
+  mad_stream_finish(&stream);
+
+  return status;
+}
+
+/*
+ * NAME:	bands()
+ * DESCRIPTION:	compare the Layer III band energies of a bitstream taken
+ *		before and after the back end; return their ratio in dB
+ */
+static
+double bands(unsigned char const *data, unsigned long length)
+{
+  struct mad_stream stream;
+  struct mad_frame frame;
+  struct mad_backend *backend;
+  struct mad_bands spectrum, subbands;
+  double before = 0, after = 0;
+  unsigned int gr, ch, sb;
+
+  mad_stream_init(&stream);
+  mad_frame_init(&frame);
+
+  backend = mad_layer_III_defer(0);
+  if (backend == 0) {
+    mad_frame_finish(&frame);
+    mad_stream_finish(&stream);
+
+    return 99;
+  }
+
+  mad_stream_buffer(&stream, data, length);
+
+  while (1) {
+    frame.backend = backend;
+
+    if (mad_frame_decode(&frame, &stream) == -1) {
+      if (!MAD_RECOVERABLE(stream.error))
+	break;
+      continue;
+    }
+
+    mad_bands_frame(&spectrum, &frame);
+    mad_layer_III_backend(&frame, 0);
+
+    frame.backend = 0;
+    mad_bands_frame(&subbands, &frame);
+
+    for (gr = 0; gr < spectrum.granules; ++gr) {
+      for (ch = 0; ch < spectrum.channels; ++ch) {
+	for (sb = 0; sb < 32; ++sb) {
+	  before += mad_f_todouble(spectrum.energy[gr][ch][sb]);
+	  after  += mad_f_todouble(subbands.energy[gr][ch][sb]);
+	}
+      }
+    }
+  }
+
+  frame.backend = backend;
+
+  mad_frame_finish(&frame);
+  mad_stream_finish(&stream);
+
+  if (before == after)
+    return 0;
+  if (before <= 0 || after <= 0)
+    return 99;
+
+  return 10 * log10(before / after);
+}
+
+/*
+ * NAME:	gains()
+ * DESCRIPTION:	decode a bitstream with and without a uniform subband gain,
+ *		and compare the first with the second times the gain
+ */
+static
+void gains(unsigned char const *data, unsigned long length,
+	   mad_fixed_t value, struct gain_result *result)
+{
+  struct mad_stream stream[2];
+  struct mad_frame frame[2];
+  struct mad_synth synth[2];
+  struct mad_gain gain;
+  mad_fixed_t target[2][32];
+  double factor, sum2 = 0;
+  unsigned long samples = 0;
+  unsigned int i, ch, sb, s, ns;
+
+  for (ch = 0; ch < 2; ++ch) {
+    for (sb = 0; sb < 32; ++sb)
+      target[ch][sb] = value;
+  }
+
+  mad_gain_init(&gain);
+  mad_gain_set(&gain, target, 0);
+
+  factor = mad_f_todouble(value);
+
+  for (i = 0; i < 2; ++i) {
+    mad_stream_init(&stream[i]);
+    mad_frame_init(&frame[i]);
+    mad_synth_init(&synth[i]);
+
+    mad_stream_buffer(&stream[i], data, length);
+  }
+
+  frame[1].gain = &gain;
+
+  result->max = 0;
+
+  while (1) {
+    struct mad_pcm *pcm = &synth[0].pcm;
+    int status[2];
+
+    for (i = 0; i < 2; ++i) {
+      do
+	status[i] = mad_frame_decode(&frame[i], &stream[i]);
+      while (status[i] == -1 && MAD_RECOVERABLE(stream[i].error));
+    }
+
+    if (status[0] == -1 || status[1] == -1)
+      break;
+
+    /* subband samples: the gained ones must saturate, not wrap */
+
+    ns = MAD_NSBSAMPLES(&frame[0].header);
+
+    for (ch = 0; ch < MAD_NCHANNELS(&frame[0].header); ++ch) {
+      for (s = 0; s < ns; ++s) {
+	for (sb = 0; sb < 32; ++sb) {
+	  double ref = mad_f_todouble(frame[0].sbsample[ch][s][sb]) * factor;
+	  double diff;
+
+	  if (ref > mad_f_todouble(MAD_GAIN_CEIL))
+	    ref = mad_f_todouble(MAD_GAIN_CEIL);
+	  else if (ref < -mad_f_todouble(MAD_GAIN_CEIL))
+	    ref = -mad_f_todouble(MAD_GAIN_CEIL);
+
+	  diff = fabs(mad_f_todouble(frame[1].sbsample[ch][s][sb]) - ref);
+	  if (diff > result->max)
+	    result->max = diff;
+	}
+      }
+    }
+
+    /* PCM, clipped to full scale */
+
+    for (i = 0; i < 2; ++i)
+      mad_synth_frame(&synth[i], &frame[i]);
+
+    for (ch = 0; ch < pcm->channels; ++ch) {
+      for (s = 0; s < pcm->length; ++s) {
+	double ref = mad_f_todouble(pcm->samples[ch][s]) * factor;
+	double diff;
+
+	ref  = (ref > 1) ? 1 : (ref < -1) ? -1 : ref;
+	diff = sample(synth[1].pcm.samples[ch][s]) - ref;
+
+	sum2 += diff * diff;
+	++samples;
+      }
+    }
+  }
+
+  for (i = 0; i < 2; ++i) {
+    mad_synth_finish(&synth[i]);
+    mad_frame_finish(&frame[i]);
+    mad_stream_finish(&stream[i]);
+  }
+
+  result->rms = samples ? sqrt(sum2 / samples) : 0;
+}
+
+/*
+ * NAME:	gain_check()
+ * DESCRIPTION:	run the subband gain checks on a corpus case; return -1 if
+ *		memory runs out
+ */
+static
+int gain_check(struct corpus_case const *tc, double seconds,
+	       unsigned char const *data, unsigned long length,
+	       struct gain_result *result)
+{
+  struct gain_result half, full, hot;
+  unsigned char *loud;
+  int attenuation;
+
+  gains(data, length, MAD_F_ONE / 2, &half);
+  gains(data, length, MAD_GAIN_MAX,  &full);
+
+  attenuation = corpus_attenuation;
+  corpus_attenuation = 0;
+
+  length = corpus_synthesize(tc, seconds, &loud);
+
+  corpus_attenuation = attenuation;
+
+  if (length == 0)
+    return -1;
+
+  gains(loud, length, MAD_GAIN_MAX, &hot);
+  free(loud);
+
+  result->rms = (half.rms > full.rms) ? half.rms : full.rms;
+  result->max = (half.max > full.max) ? half.max : full.max;
+
+  if (hot.max > result->max)
+    result->max = hot.max;
+
+  return 0;
+}
+
+/*
+ * NAME:	classify()
+ * DESCRIPTION:	return the ISO/IEC 11172-4 accuracy class of a decode
+ */
+static
+enum class classify(double rms, double max)
+{
+  if (rms < ldexp(1, -15) / sqrt(12) && max <= ldexp(1, -14))
+    return CLASS_FULL;
+  if (rms < ldexp(1, -11) / sqrt(12))
+    return CLASS_LIMITED;
+
+  return CLASS_NONE;
+}
+
+int main(int argc, char *argv[])
+{
+  char const *path = 0, *golden_path = 0, *variant = 0;
+  enum class required = CLASS_LIMITED;
+  double seconds = 1;
+  int writing = 0, status = 0, arg, ngolden = 0, g;
+  unsigned int c;
+  FILE *file;
+  static struct golden golden[GOLDEN_MAX];
+
+  corpus_attenuation = 60;
+
+  for (arg = 1; arg < argc; ++arg) {
+    if (strcmp(argv[arg], "-s") == 0 && arg + 1 < argc)
+      seconds = atof(argv[++arg]);
+    else if (strcmp(argv[arg], "-a") == 0 && arg + 1 < argc)
+      corpus_attenuation = atoi(argv[++arg]);
+    else if (strcmp(argv[arg], "-c") == 0 && arg + 1 < argc) {
+      ++arg;
+      if (strcmp(argv[arg], "full") == 0)
+	required = CLASS_FULL;
+      else if (strcmp(argv[arg], "limited") == 0)
+	required = CLASS_LIMITED;
+      else if (strcmp(argv[arg], "none") == 0)
+	required = CLASS_NONE;
+      else
+	break;
+    }
+    else if (strcmp(argv[arg], "-g") == 0 && arg + 2 < argc) {
+      golden_path = argv[++arg];
+      variant     = argv[++arg];
+    }
+    else if (strcmp(argv[arg], "-w") == 0 && arg + 1 < argc) {
+      writing = 1;
+      path  = argv[++arg];
+    }
+    else if (strcmp(argv[arg], "-r") == 0 && arg + 1 < argc) {
+      writing = 0;
+      path  = argv[++arg];
+    }
+    else
+      break;
+  }
+
+  if (arg < argc || path == 0 || seconds <= 0) {
+    fprintf(stderr, "usage: %s [-s seconds] [-a dB] -w file\n"
+	    "       %s [-s seconds] [-a dB] [-c full|limited|none]\n"
+	    "       %*s [-g file variant] -r file\n",
+	    argv[0], argv[0], (int) strlen(argv[0]), "");
+    return 1;
+  }
+
+  /* the golden hashes hold only for the default corpus settings */
+
+  if (golden_path && seconds == 1 && corpus_attenuation == 60) {
+    ngolden = golden_load(golden_path, variant, golden);
+    if (ngolden == -1) {
+      fprintf(stderr, "%s: %s: cannot read golden hashes\n",
+	      argv[0], golden_path);
+      return 2;
+    }
+  }
+
+  file = fopen(path, writing ? "wb" : "rb");
+  if (file == 0) {
+    perror(path);
+    return 2;
+  }
+
+  if (!writing) {
+    printf("{\n");
+    printf("  \"build\": \"%s\",\n", mad_build);
+    printf("  \"required\": \"%s\",\n", class_names[required]);
+    printf("  \"golden\": %d,\n", ngolden);
+    printf("  \"cases\": [");
+  }
+
+  for (c = 0; c < corpus_size; ++c) {
+    struct corpus_case const *tc = &corpus[c];
+    struct result result;
+    struct gain_result gain;
+    unsigned char *data;
+    unsigned long length;
+    double rms, bands_db = 0;
+    enum class class;
+    int error;
+
+    length = corpus_synthesize(tc, seconds, &data);
+    if (length == 0) {
+      fprintf(stderr, "%s: not enough memory\n", argv[0]);
+      status = 2;
+      break;
+    }
+
+    error = decode(data, length, file, writing, &result);
+    if (!error && !writing) {
+      if (tc->layer == 3)
+	bands_db = bands(data, length);
+
+      if (gain_check(tc, seconds, data, length, &gain) == -1) {
+	fprintf(stderr, "%s: not enough memory\n", argv[0]);
+	free(data);
+	status = 2;
+	break;
+      }
+    }
+    free(data);
+
+    if (error) {
+      if (writing || ferror(file))
+	fprintf(stderr, "%s: %s: I/O error\n", argv[0], path);
+      else {
+	fprintf(stderr, "%s: %s: frames do not match the reference\n",
+		argv[0], tc->name);
+      }
+      status = writing ? 2 : 3;
+      break;
+    }
+
+    if (writing)
+      continue;
+
+    rms   = result.samples ? sqrt(result.sum2 / result.samples) : 0;
+    class = classify(rms, result.max);
+
+    if (result.errors || class < required)
+      status = 3;
+
+    for (g = 0; g < ngolden; ++g) {
+      if (strcmp(golden[g].name, tc->name) == 0)
+	break;
+    }
+
+    if (g < ngolden && golden[g].hash != result.hash)
+      status = 3;
+
+    if (fabs(bands_db) > BANDS_TOLERANCE)
+      status = 3;
+
+    if ((required > CLASS_NONE && classify(gain.rms, 1) < CLASS_LIMITED) ||
+	gain.max > GAIN_TOLERANCE)
+      status = 3;
+
+    printf("%s\n    {\n", c ? "," : "");
+    printf("      \"name\": \"%s\",\n", tc->name);
+    printf("      \"samples\": %lu,\n", result.samples);
+    printf("      \"errors\": %lu,\n", result.errors);
+    printf("      \"rms_error\": %.3e,\n", rms);
+    printf("      \"max_error\": %.3e,\n", result.max);
+    printf("      \"rms_bits\": %.2f,\n", rms > 0 ? -log(rms) / log(2) : 99.);
+    printf("      \"class\": \"%s\",\n", class_names[class]);
+    if (tc->layer == 3)
+      printf("      \"bands_db\": %.2f,\n", bands_db);
+    else
+      printf("      \"bands_db\": null,\n");
+    printf("      \"gain_rms_bits\": %.2f,\n",
+	   gain.rms > 0 ? -log(gain.rms) / log(2) : 99.);
+    printf("      \"gain_max_error\": %.3e,\n", gain.max);
+    printf("      \"hash\": \"%08lx\",\n", result.hash);
+    printf("      \"golden\": %s\n", g == ngolden ? "null" :
+	   golden[g].hash == result.hash ? "true" : "false");
+    printf("    }");
+  }
+
+  if (!writing) {
+    printf("\n  ],\n");
+    printf("  \"pass\": %s\n}\n", status == 0 ? "true" : "false");
+  }
+
+  if (fclose(file) == EOF && status == 0)
+    status = 2;
+
+  return status;
+}
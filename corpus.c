@@ -0,0 +1,808 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * $Id$
+ */
+
+# include <stdlib.h>
+# include <string.h>
+
+# include "mad.h"
+# include "corpus.h"
+
+/*
+ * The streams are synthesized from a fixed seed per case, so the corpus is
+ * reproducible and no sample files are needed. Their spectral content is
+ * pseudo-random: they are meant to exercise the decoder, not to be
+ * listened to.
+ */
+
+struct corpus_case const corpus[] = {
+  { "I-mpeg1-stereo-crc", 0, 1, 44100, 384, MAD_MODE_STEREO,         CORPUS_CRC },
+  { "I-mpeg2-joint",      1, 1, 22050, 128, MAD_MODE_JOINT_STEREO,   0 },
+  { "II-mpeg1-stereo",    0, 2, 48000, 192, MAD_MODE_STEREO,         0 },
+  { "II-mpeg1-joint",     0, 2, 44100,  96, MAD_MODE_JOINT_STEREO,   0 },
+  { "II-mpeg1-mono-crc",  0, 2, 32000,  64, MAD_MODE_SINGLE_CHANNEL, CORPUS_CRC },
+  { "II-mpeg2-stereo",    1, 2, 24000, 128, MAD_MODE_STEREO,         0 },
+  { "II-mpeg1-free",      0, 2, 48000, 480, MAD_MODE_STEREO,         CORPUS_FREE },
+  { "III-mpeg1-joint",    0, 3, 44100, 128, MAD_MODE_JOINT_STEREO,   0 },
+  { "III-mpeg1-vbr",      0, 3, 44100, 192, MAD_MODE_JOINT_STEREO,   CORPUS_VBR },
+  { "III-mpeg1-stereo",   0, 3, 48000, 256, MAD_MODE_STEREO,         0 },
+  { "III-mpeg1-short",    0, 3, 48000, 192, MAD_MODE_JOINT_STEREO,   CORPUS_SHORT },
+  { "III-mpeg1-mono-crc", 0, 3, 32000,  64, MAD_MODE_SINGLE_CHANNEL, CORPUS_CRC },
+  { "III-mpeg2-joint",    1, 3, 22050,  64, MAD_MODE_JOINT_STEREO,   0 },
+  { "III-mpeg2-vbr-crc",  1, 3, 24000,  96, MAD_MODE_STEREO,
+    CORPUS_VBR | CORPUS_CRC },
+  { "III-mpeg25-mono",    2, 3, 11025,  32, MAD_MODE_SINGLE_CHANNEL, 0 },
+  { "III-mpeg1-free",     0, 3, 48000, 480, MAD_MODE_JOINT_STEREO,   CORPUS_FREE }
+};
+
+unsigned int const corpus_size = sizeof(corpus) / sizeof(corpus[0]);
+
+unsigned int corpus_attenuation;
+
+static
+unsigned int const bitrate_table[5][15] = {
+  /* MPEG-1 */
+  { 0,  32,  64,  96, 128, 160, 192, 224,	/* Layer I   */
+       256, 288, 320, 352, 384, 416, 448 },
+  { 0,  32,  48,  56,  64,  80,  96, 112,	/* Layer II  */
+       128, 160, 192, 224, 256, 320, 384 },
+  { 0,  32,  40,  48,  56,  64,  80,  96,	/* Layer III */
+       112, 128, 160, 192, 224, 256, 320 },
+
+  /* MPEG-2 LSF */
+  { 0,  32,  48,  56,  64,  80,  96, 112,	/* Layer I     */
+       128, 144, 160, 176, 192, 224, 256 },
+  { 0,   8,  16,  24,  32,  40,  48,  56,	/* Layers      */
+        64,  80,  96, 112, 128, 144, 160 }	/* II & III    */
+};
+
+static
+unsigned int const samplerate_table[3] = { 44100, 48000, 32000 };
+
+/* Layer II tables; see layer12.c */
+
+static
+struct {
+  unsigned int sblimit;
+  unsigned char const offsets[30];
+} const sbquant_table[5] = {
+  { 27, { 7, 7, 7, 6, 6, 6, 6, 6, 6, 6, 6, 3, 3, 3, 3, 3,
+	  3, 3, 3, 3, 3, 3, 3, 0, 0, 0, 0 } },
+  { 30, { 7, 7, 7, 6, 6, 6, 6, 6, 6, 6, 6, 3, 3, 3, 3, 3,
+	  3, 3, 3, 3, 3, 3, 3, 0, 0, 0, 0, 0, 0, 0 } },
+  {  8, { 5, 5, 2, 2, 2, 2, 2, 2 } },
+  { 12, { 5, 5, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2 } },
+  { 30, { 4, 4, 4, 4, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1,
+	  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 } }
+};
+
+static
+struct {
+  unsigned short nbal;
+  unsigned short offset;
+} const bitalloc_table[8] = {
+  { 2, 0 }, { 2, 3 }, { 3, 3 }, { 3, 1 },
+  { 4, 2 }, { 4, 3 }, { 4, 4 }, { 4, 5 }
+};
+
+static
+unsigned char const offset_table[6][15] = {
+  { 0, 1, 16                                             },
+  { 0, 1,  2, 3, 4, 5, 16                                },
+  { 0, 1,  2, 3, 4, 5,  6, 7,  8,  9, 10, 11, 12, 13, 14 },
+  { 0, 1,  3, 4, 5, 6,  7, 8,  9, 10, 11, 12, 13, 14, 15 },
+  { 0, 1,  2, 3, 4, 5,  6, 7,  8,  9, 10, 11, 12, 13, 16 },
+  { 0, 2,  4, 5, 6, 7,  8, 9, 10, 11, 12, 13, 14, 15, 16 }
+};
+
+static
+struct {
+  unsigned int nlevels;
+  unsigned char group;
+  unsigned char bits;
+} const qc_table[17] = {
+  {     3, 2,  5 }, {     5, 3,  7 }, {     7, 0,  3 }, {     9, 4, 10 },
+  {    15, 0,  4 }, {    31, 0,  5 }, {    63, 0,  6 }, {   127, 0,  7 },
+  {   255, 0,  8 }, {   511, 0,  9 }, {  1023, 0, 10 }, {  2047, 0, 11 },
+  {  4095, 0, 12 }, {  8191, 0, 13 }, { 16383, 0, 14 }, { 32767, 0, 15 },
+  { 65535, 0, 16 }
+};
+
+/* Layer III tables; see layer3.c and huffman.c */
+
+static
+struct {
+  unsigned char slen1;
+  unsigned char slen2;
+} const sflen_table[16] = {
+  { 0, 0 }, { 0, 1 }, { 0, 2 }, { 0, 3 },
+  { 3, 0 }, { 1, 1 }, { 1, 2 }, { 1, 3 },
+  { 2, 1 }, { 2, 2 }, { 2, 3 }, { 3, 1 },
+  { 3, 2 }, { 3, 3 }, { 4, 2 }, { 4, 3 }
+};
+
+/* linbits for Huffman tables 16 through 23, which share one code */
+static
+unsigned char const linbits_table[8] = { 1, 2, 3, 4, 6, 8, 10, 13 };
+
+/* table 16 codes for the values 0, 1, 2, and 15 (escape) */
+static
+struct {
+  unsigned short code;
+  unsigned char length;
+} const hcod16[4][4] = {
+  { { 0x001, 1 }, { 0x005, 4 }, { 0x00e, 6 }, { 0x011, 9 } },
+  { { 0x003, 3 }, { 0x004, 4 }, { 0x00c, 6 }, { 0x009, 8 } },
+  { { 0x00f, 6 }, { 0x00d, 6 }, { 0x017, 7 }, { 0x010, 9 } },
+  { { 0x00c, 9 }, { 0x00a, 8 }, { 0x007, 8 }, { 0x003, 8 } }
+};
+
+/* table 1 codes for the values 0 and 1 */
+static
+struct {
+  unsigned short code;
+  unsigned char length;
+} const hcod1[2][2] = {
+  { { 0x1, 1 }, { 0x1, 3 } },
+  { { 0x1, 2 }, { 0x0, 3 } }
+};
+
+struct bitwriter {
+  unsigned char *data;
+  unsigned long bit;
+};
+
+static unsigned long seed;
+
+/*
+ * NAME:	rnd()
+ * DESCRIPTION:	return a pseudo-random integer in [0, n), n <= 65536
+ */
+static
+unsigned long rnd(unsigned long n)
+{
+  seed = (seed * 1103515245UL + 12345UL) & 0xffffffffUL;
+
+  return ((seed >> 16) * n) >> 16;
+}
+
+/*
+ * NAME:	put()
+ * DESCRIPTION:	append the low len bits of value to a zeroed buffer
+ */
+static
+void put(struct bitwriter *bw, unsigned long value, unsigned int len)
+{
+  while (len--) {
+    if ((value >> len) & 1)
+      bw->data[bw->bit >> 3] |= 0x80 >> (bw->bit & 7);
+
+    ++bw->bit;
+  }
+}
+
+/*
+ * NAME:	crc16()
+ * DESCRIPTION:	compute the CRC-check word over a range of bits
+ */
+static
+unsigned int crc16(unsigned char const *data,
+		   unsigned long bit, unsigned long len, unsigned int crc)
+{
+  for (; len--; ++bit) {
+    unsigned int in = (data[bit >> 3] >> (7 - (bit & 7))) & 1;
+
+    crc = ((crc << 1) ^ ((((crc >> 15) ^ in) & 1) ? 0x8005 : 0)) & 0xffff;
+  }
+
+  return crc;
+}
+
+/*
+ * NAME:	scalefactor()
+ * DESCRIPTION:	pick a Layer I/II scalefactor index (2 dB steps)
+ */
+static
+unsigned int scalefactor(void)
+{
+  unsigned int min;
+
+  min = corpus_attenuation / 2;
+  if (min > 62)
+    min = 62;
+
+  return min + rnd(63 - min);
+}
+
+/*
+ * NAME:	global_gain()
+ * DESCRIPTION:	pick a Layer III global gain (1.5 dB steps)
+ */
+static
+unsigned int global_gain(void)
+{
+  unsigned int drop;
+
+  drop = corpus_attenuation * 2 / 3;
+  if (drop > 130)
+    drop = 130;
+
+  return 130 - drop + rnd(40);
+}
+
+/*
+ * NAME:	layer_I()
+ * DESCRIPTION:	synthesize a Layer I frame body; return protected bit count
+ */
+static
+unsigned long layer_I(struct bitwriter *bw, unsigned long end,
+		      unsigned int nch, unsigned int bound)
+{
+  unsigned int allocation[2][32], sb, ch, s, nb, limit;
+  unsigned long avail, cost;
+
+  avail = end - bw->bit - 4 * (bound * nch + (32 - bound));
+  limit = 8 + rnd(25);
+
+  for (sb = 0; sb < 32; ++sb) {
+    for (ch = 0; ch < nch; ++ch) {
+      allocation[ch][sb] = 0;
+
+      if (ch && sb >= bound) {
+	allocation[ch][sb] = allocation[0][sb];
+	continue;
+      }
+
+      nb   = 2 + rnd(14 - sb * 12 / 32);
+      cost = 12 * nb + 6 * (sb < bound ? 1 : nch);
+
+      if (sb < limit && cost <= avail) {
+	allocation[ch][sb] = nb - 1;
+	avail -= cost;
+      }
+    }
+  }
+
+  for (sb = 0; sb < 32; ++sb) {
+    for (ch = 0; ch < (sb < bound ? nch : 1); ++ch)
+      put(bw, allocation[ch][sb], 4);
+  }
+
+  for (sb = 0; sb < 32; ++sb) {
+    for (ch = 0; ch < nch; ++ch) {
+      if (allocation[ch][sb])
+	put(bw, scalefactor(), 6);
+    }
+  }
+
+  for (s = 0; s < 12; ++s) {
+    for (sb = 0; sb < 32; ++sb) {
+      for (ch = 0; ch < (sb < bound ? nch : 1); ++ch) {
+	nb = allocation[ch][sb] + 1;
+	if (nb > 1)
+	  put(bw, rnd(1UL << nb), nb);
+      }
+    }
+  }
+
+  return 4 * (bound * nch + (32 - bound));
+}
+
+/*
+ * NAME:	layer_II()
+ * DESCRIPTION:	synthesize a Layer II frame body; return protected bit count
+ */
+static
+unsigned long layer_II(struct bitwriter *bw, unsigned long end,
+		       struct corpus_case const *tc, unsigned int bitrate,
+		       unsigned int nch, unsigned int bound)
+{
+  unsigned int index, sblimit, allocation[2][32], scfsi[2][32];
+  unsigned int sb, ch, gr, s, nbal, qc, limit;
+  unsigned char const *offsets;
+  unsigned long avail, cost, start;
+
+  /* same table selection as II_decode() */
+
+  if (tc->version)
+    index = 4;
+  else if (tc->flags & CORPUS_FREE)
+    index = (tc->samplerate == 48000) ? 0 : 1;
+  else {
+    unsigned int bitrate_per_channel;
+
+    bitrate_per_channel = bitrate;
+    if (nch == 2)
+      bitrate_per_channel /= 2;
+
+    if (bitrate_per_channel <= 48)
+      index = (tc->samplerate == 32000) ? 3 : 2;
+    else if (bitrate_per_channel <= 80)
+      index = 0;
+    else
+      index = (tc->samplerate == 48000) ? 0 : 1;
+  }
+
+  sblimit = sbquant_table[index].sblimit;
+  offsets = sbquant_table[index].offsets;
+
+  if (bound > sblimit)
+    bound = sblimit;
+
+  avail = end - bw->bit;
+  for (sb = 0; sb < sblimit; ++sb)
+    avail -= bitalloc_table[offsets[sb]].nbal * (sb < bound ? nch : 1);
+
+  limit = 4 + rnd(sblimit - 3);
+
+  for (sb = 0; sb < sblimit; ++sb) {
+    nbal = bitalloc_table[offsets[sb]].nbal;
+
+    for (ch = 0; ch < nch; ++ch) {
+      allocation[ch][sb] = 0;
+      scfsi[ch][sb] = rnd(4);
+
+      if (ch && sb >= bound) {
+	allocation[ch][sb] = allocation[0][sb];
+	continue;
+      }
+
+      index = 1 + rnd((1 << nbal) - 1);
+      qc    = offset_table[bitalloc_table[offsets[sb]].offset][index - 1];
+      cost  = 12 * (qc_table[qc].group ?
+		    qc_table[qc].bits : 3 * qc_table[qc].bits) +
+	(2 + 18) * (sb < bound ? 1 : nch);
+
+      if (sb < limit && cost <= avail) {
+	allocation[ch][sb] = index;
+	avail -= cost;
+      }
+    }
+  }
+
+  start = bw->bit;
+
+  for (sb = 0; sb < sblimit; ++sb) {
+    nbal = bitalloc_table[offsets[sb]].nbal;
+
+    for (ch = 0; ch < (sb < bound ? nch : 1); ++ch)
+      put(bw, allocation[ch][sb], nbal);
+  }
+
+  for (sb = 0; sb < sblimit; ++sb) {
+    for (ch = 0; ch < nch; ++ch) {
+      if (allocation[ch][sb])
+	put(bw, scfsi[ch][sb], 2);
+    }
+  }
+
+  end = bw->bit;
+
+  for (sb = 0; sb < sblimit; ++sb) {
+    for (ch = 0; ch < nch; ++ch) {
+      if (allocation[ch][sb]) {
+	s = (scfsi[ch][sb] == 0) ? 3 : (scfsi[ch][sb] == 2) ? 1 : 2;
+	while (s--)
+	  put(bw, scalefactor(), 6);
+      }
+    }
+  }
+
+  for (gr = 0; gr < 12; ++gr) {
+    for (sb = 0; sb < sblimit; ++sb) {
+      for (ch = 0; ch < (sb < bound ? nch : 1); ++ch) {
+	if (allocation[ch][sb] == 0)
+	  continue;
+
+	nbal = bitalloc_table[offsets[sb]].nbal;
+	qc   = offset_table[bitalloc_table[offsets[sb]].offset]
+	  [allocation[ch][sb] - 1];
+
+	if (qc_table[qc].group) {
+	  unsigned long nlevels = qc_table[qc].nlevels;
+
+	  put(bw, rnd(nlevels * nlevels * nlevels), qc_table[qc].bits);
+	}
+	else {
+	  for (s = 0; s < 3; ++s)
+	    put(bw, rnd(qc_table[qc].nlevels), qc_table[qc].bits);
+	}
+      }
+    }
+  }
+
+  return end - start;
+}
+
+struct granule {
+  unsigned int part2_3_length;
+  unsigned int big_values;
+  unsigned int global_gain;
+  unsigned int scalefac_compress;
+  unsigned int block_type;
+  unsigned int mixed;
+  unsigned int table_select;
+  unsigned int region0_count;
+  unsigned int region1_count;
+  unsigned int subblock_gain[3];
+  unsigned int flags;		/* [preflag,] scalefac_scale, count1table */
+};
+
+/*
+ * NAME:	III_value()
+ * DESCRIPTION:	pick a quantized value index for a Layer III pair
+ */
+static
+unsigned int III_value(unsigned int table)
+{
+  unsigned int r = rnd(16);
+
+  if (table == 1)
+    return r >= 10;
+
+  return (r < 8) ? 0 : (r < 12) ? 1 : (r < 15) ? 2 : 3;
+}
+
+/*
+ * NAME:	III_channel()
+ * DESCRIPTION:	synthesize one granule's main data for one channel
+ */
+static
+void III_channel(struct bitwriter *bw, unsigned long budget,
+		 struct granule *channel, int lsf, unsigned int gr,
+		 unsigned int scfsi)
+{
+  unsigned long start = bw->bit;
+  unsigned int linbits = 0, i, n, pairs, quads, lin[2], v[2];
+
+  /* part2: scalefactors (LSF streams use scalefac_compress 0) */
+
+  if (!lsf) {
+    unsigned int slen1, slen2;
+
+    slen1 = sflen_table[channel->scalefac_compress].slen1;
+    slen2 = sflen_table[channel->scalefac_compress].slen2;
+
+    if (channel->block_type == 2) {
+      for (i = 0, n = channel->mixed ? 8 + 3 * 3 : 6 * 3; i < n; ++i)
+	put(bw, rnd(1UL << slen1), slen1);
+      for (i = 0; i < 6 * 3; ++i)
+	put(bw, rnd(1UL << slen2), slen2);
+    }
+    else {
+      for (i = 0; i < 21; ++i) {
+	unsigned int group = (i < 6) ? 0 : (i < 11) ? 1 : (i < 16) ? 2 : 3;
+
+	if (gr == 1 && (scfsi & (0x8 >> group)))
+	  continue;
+
+	n = (i < 11) ? slen1 : slen2;
+	put(bw, rnd(1UL << n), n);
+      }
+    }
+  }
+
+  /* part3: big_values */
+
+  if (channel->table_select >= 16)
+    linbits = linbits_table[channel->table_select - 16];
+
+  pairs = rnd(289);
+
+  for (n = 0; n < pairs; ++n) {
+    if (bw->bit - start + 2 * (9 + 13 + 1) > budget)
+      break;
+
+    for (i = 0; i < 2; ++i) {
+      v[i]   = III_value(channel->table_select);
+      lin[i] = (v[i] == 3) ? rnd(1UL << linbits) : 0;
+    }
+
+    if (channel->table_select == 1)
+      put(bw, hcod1[v[0]][v[1]].code, hcod1[v[0]][v[1]].length);
+    else
+      put(bw, hcod16[v[0]][v[1]].code, hcod16[v[0]][v[1]].length);
+
+    for (i = 0; i < 2; ++i) {
+      if (v[i] == 3)
+	put(bw, lin[i], linbits);
+      if (v[i])
+	put(bw, rnd(2), 1);
+    }
+  }
+
+  channel->big_values = n;
+
+  /* part3: count1 (table B) */
+
+  quads = rnd((576 - 2 * channel->big_values) / 4 + 1);
+
+  for (n = 0; n < quads; ++n) {
+    unsigned int quad = rnd(16) & rnd(16);
+
+    if (bw->bit - start + 4 + 4 > budget)
+      break;
+
+    put(bw, ~quad & 0xf, 4);
+
+    for (i = 0; i < 4; ++i) {
+      if (quad & (0x8 >> i))
+	put(bw, rnd(2), 1);
+    }
+  }
+
+  channel->part2_3_length = bw->bit - start;
+}
+
+/*
+ * NAME:	layer_III()
+ * DESCRIPTION:	synthesize a Layer III frame; return protected bit count
+ */
+static
+unsigned long layer_III(struct bitwriter *bw, unsigned long end,
+			unsigned long frame, struct corpus_case const *tc,
+			unsigned int nch, unsigned long *reserve)
+{
+  static unsigned char main_data[4096];
+  struct granule granule[2][2];
+  struct bitwriter md;
+  unsigned char *tail;
+  unsigned int lsf, ngr, gr, ch, i, si_len, scfsi[2];
+  unsigned long slot, begin, target, used;
+
+  lsf    = tc->version != 0;
+  ngr    = lsf ? 1 : 2;
+  si_len = lsf ? ((nch == 1) ? 9 : 17) : ((nch == 1) ? 17 : 32);
+
+  slot  = (end - bw->bit) / 8 - si_len;
+  begin = *reserve;
+  if (begin > (lsf ? 255 : 511))
+    begin = lsf ? 255 : 511;
+
+  /* use part of the available main data, leaving the rest in the reservoir */
+
+  target = (begin + slot) * (75 + rnd(26)) / 100;
+
+  /* choose block types, shared by both channels */
+
+  for (gr = 0; gr < ngr; ++gr) {
+    unsigned int block_type = 0, mixed = 0;
+
+    if ((tc->flags & CORPUS_SHORT) || rnd(8) == 0) {
+      block_type = (tc->flags & CORPUS_SHORT) ? 2 : 1 + rnd(3);
+      mixed = (block_type == 2) && rnd(4) == 0;
+    }
+
+    for (ch = 0; ch < nch; ++ch) {
+      struct granule *channel = &granule[gr][ch];
+
+      channel->block_type        = block_type;
+      channel->mixed             = mixed;
+      channel->global_gain       = global_gain();
+      channel->scalefac_compress = lsf ? 0 : rnd(16);
+      channel->table_select      = rnd(2) ? 1 : 16 + rnd(8);
+      channel->region0_count     = rnd(16);
+      channel->region1_count     = rnd(8);
+      channel->flags             = (lsf ? 0 : rnd(2) << 2) | rnd(2) << 1 | 1;
+
+      for (i = 0; i < 3; ++i)
+	channel->subblock_gain[i] = rnd(8);
+    }
+  }
+
+  for (ch = 0; ch < nch; ++ch) {
+    scfsi[ch] = 0;
+    if (!lsf && granule[0][ch].block_type != 2 &&
+	granule[1][ch].block_type != 2)
+      scfsi[ch] = rnd(16);
+  }
+
+  /* main data */
+
+  memset(main_data, 0, sizeof(main_data));
+  md.data = main_data;
+  md.bit  = 0;
+
+  for (gr = 0; gr < ngr; ++gr) {
+    for (ch = 0; ch < nch; ++ch) {
+      unsigned long budget;
+
+      budget = target * 8 / (ngr * nch);
+      if (budget > 4095)
+	budget = 4095;
+
+      III_channel(&md, budget, &granule[gr][ch], lsf, gr, scfsi[ch]);
+    }
+  }
+
+  used = (md.bit + 7) / 8;
+
+  /* side information */
+
+  put(bw, begin, lsf ? 8 : 9);
+  put(bw, 0, lsf ? ((nch == 1) ? 1 : 2) : ((nch == 1) ? 5 : 3));
+
+  for (ch = 0; !lsf && ch < nch; ++ch)
+    put(bw, scfsi[ch], 4);
+
+  for (gr = 0; gr < ngr; ++gr) {
+    for (ch = 0; ch < nch; ++ch) {
+      struct granule *channel = &granule[gr][ch];
+
+      put(bw, channel->part2_3_length, 12);
+      put(bw, channel->big_values, 9);
+      put(bw, channel->global_gain, 8);
+      put(bw, channel->scalefac_compress, lsf ? 9 : 4);
+
+      if (channel->block_type) {
+	put(bw, 1, 1);
+	put(bw, channel->block_type, 2);
+	put(bw, channel->mixed, 1);
+	for (i = 0; i < 2; ++i)
+	  put(bw, channel->table_select, 5);
+	for (i = 0; i < 3; ++i)
+	  put(bw, channel->subblock_gain[i], 3);
+      }
+      else {
+	put(bw, 0, 1);
+	for (i = 0; i < 3; ++i)
+	  put(bw, channel->table_select, 5);
+	put(bw, channel->region0_count, 4);
+	put(bw, channel->region1_count, 3);
+      }
+
+      put(bw, channel->flags, lsf ? 2 : 3);
+    }
+  }
+
+  /* main data begins in the tail of the previous frame */
+
+  tail = bw->data + frame / 8 - begin;
+
+  if (used > begin) {
+    memcpy(tail, main_data, begin);
+    memcpy(bw->data + bw->bit / 8, main_data + begin, used - begin);
+  }
+  else
+    memcpy(tail, main_data, used);
+
+  *reserve = (used > begin) ? slot - (used - begin) : slot;
+
+  return si_len * 8;
+}
+
+/*
+ * NAME:	corpus->synthesize()
+ * DESCRIPTION:	generate the bitstream for a test case; return its length
+ */
+unsigned long corpus_synthesize(struct corpus_case const *tc, double seconds,
+				unsigned char **data)
+{
+  struct bitwriter bw;
+  unsigned int nch, row, sfreq, index, bitrate, factor, pad, mode_ext, bound;
+  unsigned long nframes, size, frame, end, protected, reserve, rest, i;
+
+  nch = (tc->mode == MAD_MODE_SINGLE_CHANNEL) ? 1 : 2;
+  row = tc->version ? 3 + (tc->layer >> 1) : tc->layer - 1;
+
+  for (sfreq = 0; sfreq < 2; ++sfreq) {
+    if ((samplerate_table[sfreq] >> tc->version) == tc->samplerate)
+      break;
+  }
+
+  factor = (tc->layer == 1) ? 12 :
+    (tc->layer == 3 && tc->version) ? 72 : 144;
+
+  nframes = seconds * tc->samplerate /
+    ((tc->layer == 1) ? 384 : (tc->layer == 3 && tc->version) ? 576 : 1152);
+
+  /* room for every frame at the highest bitrate, plus the guard */
+
+  size = nframes * (factor * 640000UL / tc->samplerate + 1) *
+    ((tc->layer == 1) ? 4 : 1) + MAD_BUFFER_GUARD;
+
+  bw.data = calloc(size, 1);
+  bw.bit  = 0;
+
+  if (bw.data == 0)
+    return 0;
+
+  seed    = tc - corpus + 1;
+  reserve = rest = 0;
+
+  for (i = 0; i < nframes; ++i) {
+    index   = 0;
+    bitrate = tc->bitrate;
+    pad     = 0;
+
+    if (!(tc->flags & CORPUS_FREE)) {
+      while (bitrate_table[row][index] < tc->bitrate)
+	++index;
+
+      if (tc->flags & CORPUS_VBR) {
+	index += rnd(7);
+	index  = (index < 4) ? 1 : (index - 3 > 14) ? 14 : index - 3;
+      }
+
+      bitrate = bitrate_table[row][index];
+
+      /* padding keeps the average bitrate exact */
+
+      rest += factor * bitrate * 1000UL % tc->samplerate;
+      if (rest >= tc->samplerate) {
+	rest -= tc->samplerate;
+	pad = 1;
+      }
+    }
+
+    frame = bw.bit;
+    end   = frame + 8 * (factor * bitrate * 1000UL / tc->samplerate + pad) *
+      ((tc->layer == 1) ? 4 : 1);
+
+    mode_ext = (tc->mode == MAD_MODE_JOINT_STEREO) ? rnd(4) : 0;
+    bound    = (tc->mode == MAD_MODE_JOINT_STEREO) ? 4 + 4 * mode_ext : 32;
+
+    /* header */
+
+    put(&bw, 0x7ff, 11);
+    put(&bw, (tc->version == 0) ? 3 : (tc->version == 1) ? 2 : 0, 2);
+    put(&bw, 4 - tc->layer, 2);
+    put(&bw, !(tc->flags & CORPUS_CRC), 1);
+    put(&bw, index, 4);
+    put(&bw, sfreq, 2);
+    put(&bw, pad, 1);
+    put(&bw, 0, 1);			/* private_bit */
+    put(&bw, 3 - tc->mode, 2);		/* mode */
+    put(&bw, mode_ext, 2);
+    put(&bw, 0, 4);			/* copyright, original, emphasis */
+
+    if (tc->flags & CORPUS_CRC)
+      put(&bw, 0, 16);
+
+    switch (tc->layer) {
+    case 1:
+      protected = layer_I(&bw, end, nch, bound);
+      break;
+
+    case 2:
+      protected = layer_II(&bw, end, tc, bitrate, nch, bound);
+      break;
+
+    default:
+      protected = layer_III(&bw, end, frame, tc, nch, &reserve);
+    }
+
+    if (tc->flags & CORPUS_CRC) {
+      unsigned int crc;
+
+      crc = crc16(bw.data, frame + 16, 16, 0xffff);
+      crc = crc16(bw.data, frame + 48, protected, crc);
+
+      bw.data[frame / 8 + 4] = crc >> 8;
+      bw.data[frame / 8 + 5] = crc & 0xff;
+    }
+
+    bw.bit = end;
+  }
+
+  *data = bw.data;
+
+  return bw.bit / 8 + MAD_BUFFER_GUARD;
+}
@@ -0,0 +1,58 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * $Id$
+ */
+
+# ifndef LIBMAD_CORPUS_H
+# define LIBMAD_CORPUS_H
+
+/*
+ * The benchmark corpus: a set of bitstream descriptions from which
+ * syntactically valid MPEG audio streams with pseudo-random content are
+ * synthesized. This header uses enum mad_mode and must be included after
+ * mad.h (or frame.h).
+ */
+
+enum {
+  CORPUS_CRC   = 0x0001,	/* frames are protected by a CRC */
+  CORPUS_VBR   = 0x0002,	/* bitrate changes from frame to frame */
+  CORPUS_FREE  = 0x0004,	/* free format bitrate */
+  CORPUS_SHORT = 0x0008		/* Layer III granules use short blocks */
+};
+
+struct corpus_case {
+  char const *name;
+  unsigned int version;		/* 0 = MPEG-1, 1 = MPEG-2 LSF, 2 = MPEG 2.5 */
+  unsigned int layer;
+  unsigned int samplerate;
+  unsigned int bitrate;		/* kbps (average for VBR) */
+  enum mad_mode mode;
+  int flags;
+};
+
+extern struct corpus_case const corpus[];
+extern unsigned int const corpus_size;
+
+/* level reduction in dB of subsequently synthesized streams (default 0) */
+extern unsigned int corpus_attenuation;
+
+unsigned long corpus_synthesize(struct corpus_case const *, double,
+				unsigned char **);
+
+# endif
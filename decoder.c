@@ -42,6 +42,7 @@
 # endif
 
 # include <stdlib.h>
+# include <string.h>
 
 # ifdef HAVE_ERRNO_H
 #  include <errno.h>
@@ -51,6 +52,10 @@
 # include "frame.h"
 # include "synth.h"
 # include "decoder.h"
+# include "layer3.h"
+# include "pool.h"
+# include "alloc.h"
+# include "stats.h"
 
 /*
  * NAME:	decoder->init()
@@ -76,6 +81,8 @@ void mad_decoder_init(struct mad_decoder *decoder, void *data,
   decoder->mode         = -1;
 
   decoder->options      = 0;
+  decoder->allocator    = 0;
+  decoder->gain         = 0;
 
   decoder->async.pid    = 0;
   decoder->async.in     = -1;
@@ -83,6 +90,11 @@ void mad_decoder_init(struct mad_decoder *decoder, void *data,
 
   decoder->sync         = 0;
 
+  decoder->restore.data   = 0;
+  decoder->restore.length = 0;
+
+  memset(&decoder->stats, 0, sizeof(decoder->stats));
+
   decoder->cb_data      = data;
 
   decoder->input_func   = input_func;
@@ -91,6 +103,8 @@ void mad_decoder_init(struct mad_decoder *decoder, void *data,
   decoder->output_func  = output_func;
   decoder->error_func   = error_func;
   decoder->message_func = message_func;
+
+  decoder->bands_func   = 0;
 }
 
 int mad_decoder_finish(struct mad_decoder *decoder)
@@ -312,8 +326,221 @@ enum mad_flow error_default(void *data, struct mad_stream *stream,
   }
 }
 
+/*
+ * A snapshot is the state needed to resume decoding bit-exactly at the
+ * frame following the one last output. All integers are big-endian:
+ *
+ *   magic "MAD" + version	 4 bytes
+ *   flags			 1 byte	 (SNAPSHOT_SYNC, SNAPSHOT_OVERLAP)
+ *   synthesis phase		 1 byte
+ *   main_data length		 2 bytes
+ *   free format bitrate	 4 bytes
+ *   timer seconds, fraction	 8 bytes
+ *   stream sample count	 8 bytes (high word first)
+ *   main_data			 md_len bytes
+ *   synthesis filter		 4 bytes each
+ *   Layer III overlap		 4 bytes each (only with SNAPSHOT_OVERLAP)
+ *
+ * The filter and overlap are stored as 28-bit fixed-point words, which
+ * cannot hold the double precision state of FPM_FLOAT without rounding it,
+ * so that build neither takes nor restores snapshots.
+ */
+
+# define SNAPSHOT_VERSION	2
+# define SNAPSHOT_HEADER	28
+# define SNAPSHOT_FILTER	(2 * 2 * 2 * 16 * 8)
+# define SNAPSHOT_OVERLAP_LEN	(2 * 32 * 18)
+
+enum {
+  SNAPSHOT_SYNC    = 0x01,
+  SNAPSHOT_OVERLAP = 0x02
+};
+
+# if !defined(FPM_FLOAT)
 static
-int run_sync(struct mad_decoder *decoder)
+unsigned char *put32(unsigned char *ptr, unsigned long value)
+{
+  ptr[0] = (value >> 24) & 0xff;
+  ptr[1] = (value >> 16) & 0xff;
+  ptr[2] = (value >>  8) & 0xff;
+  ptr[3] = (value >>  0) & 0xff;
+
+  return ptr + 4;
+}
+# endif
+
+static
+unsigned long get32(unsigned char const *ptr)
+{
+  return ((unsigned long) ptr[0] << 24) | ((unsigned long) ptr[1] << 16) |
+         ((unsigned long) ptr[2] <<  8) | ((unsigned long) ptr[3] <<  0);
+}
+
+static
+signed long get32s(unsigned char const *ptr)
+{
+  return (signed long) (get32(ptr) ^ 0x80000000UL) - 0x7fffffffL - 1;
+}
+
+/*
+ * NAME:	snapshot_size()
+ * DESCRIPTION:	validate a snapshot header and return its full length, or 0
+ */
+static
+unsigned int snapshot_size(unsigned char const *ptr, unsigned int len)
+{
+  unsigned int size;
+
+  if (len < SNAPSHOT_HEADER ||
+      ptr[0] != 'M' || ptr[1] != 'A' || ptr[2] != 'D' ||
+      ptr[3] != SNAPSHOT_VERSION || ptr[5] >= 16)
+    return 0;
+
+  size = (ptr[6] << 8) | ptr[7];
+  if (size > MAD_BUFFER_MDLEN)
+    return 0;
+
+  size += SNAPSHOT_HEADER + 4 * SNAPSHOT_FILTER;
+  if (ptr[4] & SNAPSHOT_OVERLAP)
+    size += 4 * SNAPSHOT_OVERLAP_LEN;
+
+  return size == len ? size : 0;
+}
+
+/*
+ * NAME:	restore_sync()
+ * DESCRIPTION:	load a snapshot into the running sync state
+ */
+static
+int restore_sync(struct mad_decoder *decoder,
+		 unsigned char const *ptr, unsigned int len)
+{
+  struct mad_stream *stream = &decoder->sync->stream;
+  struct mad_frame *frame = &decoder->sync->frame;
+  struct mad_synth *synth = &decoder->sync->synth;
+  unsigned int flags, md_len, i;
+  mad_fixed_t *value;
+
+  if (snapshot_size(ptr, len) == 0)
+    return -1;
+
+  flags  = ptr[4];
+  md_len = (ptr[6] << 8) | ptr[7];
+
+  if (stream->main_data == 0 && md_len) {
+    stream->main_data = mad_alloc(stream->allocator, MAD_BUFFER_MDLEN);
+    if (stream->main_data == 0)
+      return -1;
+  }
+
+  if (frame->overlap == 0 && (flags & SNAPSHOT_OVERLAP)) {
+    frame->overlap = mad_alloc(stream->allocator, sizeof(*frame->overlap));
+    if (frame->overlap == 0)
+      return -1;
+  }
+
+  stream->sync     = (flags & SNAPSHOT_SYNC) != 0;
+  stream->freerate = get32(&ptr[8]);
+  stream->md_len   = md_len;
+
+  synth->phase = ptr[5];
+
+  decoder->sync->timer.seconds  = get32s(&ptr[12]);
+  decoder->sync->timer.fraction = get32(&ptr[16]);
+
+  stream->samples = ((mad_samples_t) get32(&ptr[20]) << 16 << 16) |
+    get32(&ptr[24]);
+
+  ptr += SNAPSHOT_HEADER;
+
+  if (md_len) {
+    memcpy(*stream->main_data, ptr, md_len);
+    ptr += md_len;
+  }
+
+  value = &synth->filter[0][0][0][0][0];
+  for (i = 0; i < SNAPSHOT_FILTER; ++i, ptr += 4)
+    value[i] = get32s(ptr);
+
+  /* a frame without saved overlap starts from silence */
+
+  mad_frame_mute(frame);
+
+  if (flags & SNAPSHOT_OVERLAP) {
+    value = &(*frame->overlap)[0][0][0];
+    for (i = 0; i < SNAPSHOT_OVERLAP_LEN; ++i, ptr += 4)
+      value[i] = get32s(ptr);
+  }
+
+  return 0;
+}
+
+struct granules {
+  struct mad_decoder *decoder;
+  unsigned int next;			/* next granule to output */
+  enum mad_flow flow;			/* what the callbacks last asked for */
+  int ignore;				/* filter asked to skip this frame */
+};
+
+/*
+ * NAME:	output_granule()
+ * DESCRIPTION:	synthesize and output one Layer III granule, filtering the
+ *		frame once before its first granule
+ */
+static
+enum mad_flow output_granule(struct granules *granules, unsigned int gr)
+{
+  struct mad_decoder *decoder = granules->decoder;
+  struct mad_frame *frame = &decoder->sync->frame;
+  struct mad_synth *synth = &decoder->sync->synth;
+  enum mad_flow flow;
+  STATS_LAP_DECL(lap)
+
+  if (gr == 0 && decoder->filter_func) {
+    flow = decoder->filter_func(decoder->cb_data,
+				&decoder->sync->stream, frame);
+    if (flow == MAD_FLOW_IGNORE)
+      granules->ignore = 1;
+    else if (flow != MAD_FLOW_CONTINUE)
+      return flow;
+  }
+
+  if (granules->ignore)
+    return MAD_FLOW_CONTINUE;
+
+  mad_synth_granule(synth, frame, gr);
+
+  if (decoder->output_func == 0)
+    return MAD_FLOW_CONTINUE;
+
+  STATS_LAP_START(lap, &decoder->stats);
+
+  flow = decoder->output_func(decoder->cb_data, &frame->header, &synth->pcm);
+
+  STATS_LAP(lap, MAD_STAGE_OUTPUT);
+
+  return (flow == MAD_FLOW_IGNORE) ? MAD_FLOW_CONTINUE : flow;
+}
+
+/*
+ * NAME:	granule_ready()
+ * DESCRIPTION:	output a Layer III granule as soon as it has been decoded
+ */
+static
+void granule_ready(void *data, struct mad_frame *frame, unsigned int gr)
+{
+  struct granules *granules = data;
+
+  (void) frame;
+
+  if (granules->flow == MAD_FLOW_CONTINUE)
+    granules->flow = output_granule(granules, gr);
+
+  granules->next = gr + 1;
+}
+
+static
+int decode_sync(struct mad_decoder *decoder)
 {
   enum mad_flow (*error_func)(void *, struct mad_stream *, struct mad_frame *);
   void *error_data;
@@ -321,10 +548,8 @@ int run_sync(struct mad_decoder *decoder)
   struct mad_stream *stream;
   struct mad_frame *frame;
   struct mad_synth *synth;
-  int result = 0;
-
-  if (decoder->input_func == 0)
-    return 0;
+  struct granules granules;
+  unsigned int gr, ngr;
 
   if (decoder->error_func) {
     error_func = decoder->error_func;
@@ -339,12 +564,59 @@ int run_sync(struct mad_decoder *decoder)
   frame  = &decoder->sync->frame;
   synth  = &decoder->sync->synth;
 
-  mad_stream_init(stream);
-  mad_frame_init(frame);
-  mad_synth_init(synth);
+  mad_timer_reset(&decoder->sync->timer);
+
+  stream->allocator = decoder->allocator;
+  frame->gain       = decoder->gain;
+
+# if defined(OPT_STATS)
+  stream->stats = &decoder->stats;
+  synth->stats  = &decoder->stats;
+# endif
+
+  if (decoder->restore.data) {
+    if (restore_sync(decoder, decoder->restore.data,
+		     decoder->restore.length) == -1)
+      return -1;
+
+    decoder->restore.data = 0;
+  }
 
   mad_stream_options(stream, decoder->options);
 
+  /*
+   * With a bands callback, Layer III frames are only decoded through joint
+   * stereo processing: their energies are taken from the spectrum, and
+   * neither the back end nor subband synthesis is run for any layer.
+   */
+
+  if (decoder->bands_func) {
+    if (frame->backend == 0)
+      frame->backend = mad_layer_III_defer(decoder->allocator);
+  }
+  else if (frame->backend) {
+    mad_free(frame->backend);
+    frame->backend = 0;
+  }
+
+  /*
+   * With MAD_OPTION_GRANULES, each Layer III granule is synthesized and
+   * output from within mad_frame_decode() as soon as it is ready, rather
+   * than once the whole frame has been decoded. The filter is called once
+   * per frame, before its first granule, when only the subband samples of
+   * that granule (sbsample[ch][0..17]) are valid; MAD_FLOW_IGNORE skips
+   * every granule of the frame. The output callback then receives one
+   * granule of PCM (576 samples per channel, or 288 at half sample rate)
+   * per call.
+   */
+
+  granules.decoder = decoder;
+
+  if ((decoder->options & MAD_OPTION_GRANULES) && !decoder->bands_func) {
+    frame->granule_func = granule_ready;
+    frame->granule_data = &granules;
+  }
+
   do {
     switch (decoder->input_func(decoder->cb_data, stream)) {
     case MAD_FLOW_STOP:
@@ -401,7 +673,16 @@ int run_sync(struct mad_decoder *decoder)
 	}
       }
 
+      granules.next   = 0;
+      granules.flow   = MAD_FLOW_CONTINUE;
+      granules.ignore = 0;
+
       if (mad_frame_decode(frame, stream) == -1) {
+	if (granules.flow == MAD_FLOW_STOP)
+	  goto done;
+	if (granules.flow == MAD_FLOW_BREAK)
+	  goto fail;
+
 	if (!MAD_RECOVERABLE(stream->error))
 	  break;
 
@@ -420,6 +701,55 @@ int run_sync(struct mad_decoder *decoder)
       else
 	bad_last_frame = 0;
 
+      if (frame->granule_func && frame->header.layer == MAD_LAYER_III) {
+	/* output any granules the callback has not */
+
+	ngr = (frame->header.flags & MAD_FLAG_LSF_EXT) ? 1 : 2;
+
+	for (gr = granules.next;
+	     gr < ngr && granules.flow == MAD_FLOW_CONTINUE; ++gr)
+	  granules.flow = output_granule(&granules, gr);
+
+	mad_timer_add(&decoder->sync->timer, frame->header.duration);
+
+# if defined(OPT_STATS)
+	++decoder->stats.frames;
+# endif
+
+	switch (granules.flow) {
+	case MAD_FLOW_STOP:
+	  goto done;
+	case MAD_FLOW_BREAK:
+	  goto fail;
+	default:
+	  continue;
+	}
+      }
+
+      if (decoder->bands_func) {
+	struct mad_bands bands;
+
+	mad_bands_frame(&bands, frame);
+	mad_timer_add(&decoder->sync->timer, frame->header.duration);
+
+# if defined(OPT_STATS)
+	++decoder->stats.frames;
+# endif
+
+	switch (decoder->bands_func(decoder->cb_data,
+				    &frame->header, &bands)) {
+	case MAD_FLOW_STOP:
+	  goto done;
+	case MAD_FLOW_BREAK:
+	  goto fail;
+	case MAD_FLOW_IGNORE:
+	case MAD_FLOW_CONTINUE:
+	  break;
+	}
+
+	continue;
+      }
+
       if (decoder->filter_func) {
 	switch (decoder->filter_func(decoder->cb_data, stream, frame)) {
 	case MAD_FLOW_STOP:
@@ -434,10 +764,24 @@ int run_sync(struct mad_decoder *decoder)
       }
 
       mad_synth_frame(synth, frame);
+      mad_timer_add(&decoder->sync->timer, frame->header.duration);
+
+# if defined(OPT_STATS)
+      ++decoder->stats.frames;
+# endif
 
       if (decoder->output_func) {
-	switch (decoder->output_func(decoder->cb_data,
-				     &frame->header, &synth->pcm)) {
+	enum mad_flow flow;
+	STATS_LAP_DECL(lap)
+
+	STATS_LAP_START(lap, &decoder->stats);
+
+	flow = decoder->output_func(decoder->cb_data,
+				    &frame->header, &synth->pcm);
+
+	STATS_LAP(lap, MAD_STAGE_OUTPUT);
+
+	switch (flow) {
 	case MAD_FLOW_STOP:
 	  goto done;
 	case MAD_FLOW_BREAK:
@@ -452,12 +796,29 @@ int run_sync(struct mad_decoder *decoder)
   while (stream->error == MAD_ERROR_BUFLEN);
 
  fail:
-  result = -1;
+  return -1;
 
  done:
-  mad_synth_finish(synth);
-  mad_frame_finish(frame);
-  mad_stream_finish(stream);
+  return 0;
+}
+
+static
+int run_sync(struct mad_decoder *decoder)
+{
+  int result;
+
+  if (decoder->input_func == 0)
+    return 0;
+
+  mad_stream_init(&decoder->sync->stream);
+  mad_frame_init(&decoder->sync->frame);
+  mad_synth_init(&decoder->sync->synth);
+
+  result = decode_sync(decoder);
+
+  mad_synth_finish(&decoder->sync->synth);
+  mad_frame_finish(&decoder->sync->frame);
+  mad_stream_finish(&decoder->sync->stream);
 
   return result;
 }
@@ -562,6 +923,241 @@ int mad_decoder_run(struct mad_decoder *decoder, enum mad_decoder_mode mode)
   return result;
 }
 
+struct batch_job {
+  struct mad_job job;
+  struct mad_decoder *decoder;
+  struct mad_decoder *workers;		/* per-worker sync state holders */
+  int result;
+};
+
+/*
+ * NAME:	batch_run()
+ * DESCRIPTION:	decode one stream of a batch using the worker's sync state
+ */
+static
+void batch_run(void *data, unsigned int worker)
+{
+  struct batch_job *job = data;
+  struct mad_decoder *decoder = job->decoder;
+  unsigned char (*main_data)[MAD_BUFFER_MDLEN];
+  mad_fixed_t (*overlap)[2][32][18];
+  struct mad_pool *pool;
+  struct mad_backend *backend;
+
+  decoder->mode = MAD_DECODER_MODE_SYNC;
+  decoder->sync = job->workers[worker].sync;
+
+  job->result = 0;
+
+  if (decoder->input_func) {
+    /* reset the worker state, keeping the Layer III buffers for reuse */
+
+    main_data = decoder->sync->stream.main_data;
+    overlap   = decoder->sync->frame.overlap;
+    pool      = decoder->sync->frame.pool;
+    backend   = decoder->sync->frame.backend;
+
+    mad_stream_init(&decoder->sync->stream);
+    mad_frame_init(&decoder->sync->frame);
+    mad_synth_init(&decoder->sync->synth);
+
+    decoder->sync->stream.main_data = main_data;
+    decoder->sync->frame.overlap    = overlap;
+    decoder->sync->frame.pool       = pool;
+    decoder->sync->frame.backend    = backend;
+
+    if (overlap)
+      mad_frame_mute(&decoder->sync->frame);
+
+    job->result = decode_sync(decoder);
+  }
+
+  decoder->sync = 0;
+}
+
+/*
+ * NAME:	decoder->batch()
+ * DESCRIPTION:	run many independent decoders on a pool of worker threads
+ */
+int mad_decoder_batch(struct mad_decoder *decoders, unsigned int count,
+		      unsigned int nthreads, int *results)
+{
+  struct mad_decoder *workers;
+  struct batch_job *jobs;
+  struct mad_pool *pool;
+  unsigned int nworkers, i;
+  int result = -1;
+
+  if (count == 0)
+    return 0;
+
+  pool = mad_pool_create(nthreads);
+  nworkers = pool ? nthreads : 1;
+
+  jobs    = malloc(count * sizeof(*jobs));
+  workers = calloc(nworkers, sizeof(*workers));
+
+  if (jobs == 0 || workers == 0)
+    goto done;
+
+  for (i = 0; i < nworkers; ++i) {
+    workers[i].sync = malloc(sizeof(*workers[i].sync));
+    if (workers[i].sync == 0)
+      goto done;
+
+    mad_stream_init(&workers[i].sync->stream);
+    mad_frame_init(&workers[i].sync->frame);
+    mad_synth_init(&workers[i].sync->synth);
+  }
+
+  /* the decoders are independent, so completion order does not matter */
+
+  for (i = 0; i < count; ++i) {
+    jobs[i].job.func = batch_run;
+    jobs[i].job.data = &jobs[i];
+    jobs[i].decoder  = &decoders[i];
+    jobs[i].workers  = workers;
+
+    mad_pool_submit(pool, &jobs[i].job);
+  }
+
+  mad_pool_wait(pool);
+
+  result = 0;
+
+  for (i = 0; i < count; ++i) {
+    if (results)
+      results[i] = jobs[i].result;
+
+    if (jobs[i].result == -1)
+      result = -1;
+  }
+
+ done:
+  mad_pool_destroy(pool);
+
+  if (workers) {
+    for (i = 0; i < nworkers && workers[i].sync; ++i) {
+      mad_synth_finish(&workers[i].sync->synth);
+      mad_frame_finish(&workers[i].sync->frame);
+      mad_stream_finish(&workers[i].sync->stream);
+
+      free(workers[i].sync);
+    }
+
+    free(workers);
+  }
+
+  free(jobs);
+
+  return result;
+}
+
+/*
+ * NAME:	decoder->snapshot()
+ * DESCRIPTION:	serialize the state needed to resume decoding after the
+ *		last output frame; with a null buffer, report the size only
+ */
+int mad_decoder_snapshot(struct mad_decoder *decoder,
+			 void *buffer, unsigned int *len)
+{
+# if defined(FPM_FLOAT)
+  (void) decoder;
+  (void) buffer;
+  (void) len;
+
+  return -1;
+# else
+  struct mad_stream const *stream;
+  struct mad_frame const *frame;
+  struct mad_synth const *synth;
+  mad_fixed_t const *value;
+  unsigned char *ptr = buffer;
+  unsigned int size, i;
+
+  if (decoder->sync == 0 ||
+      (decoder->mode == MAD_DECODER_MODE_ASYNC && decoder->async.pid))
+    return -1;
+
+  stream = &decoder->sync->stream;
+  frame  = &decoder->sync->frame;
+  synth  = &decoder->sync->synth;
+
+  size = SNAPSHOT_HEADER + stream->md_len + 4 * SNAPSHOT_FILTER;
+  if (frame->overlap)
+    size += 4 * SNAPSHOT_OVERLAP_LEN;
+
+  if (ptr == 0 || *len < size) {
+    *len = size;
+    return ptr ? -1 : 0;
+  }
+
+  *len = size;
+
+  ptr[0] = 'M';
+  ptr[1] = 'A';
+  ptr[2] = 'D';
+  ptr[3] = SNAPSHOT_VERSION;
+  ptr[4] = (stream->sync ? SNAPSHOT_SYNC : 0) |
+           (frame->overlap ? SNAPSHOT_OVERLAP : 0);
+  ptr[5] = synth->phase;
+  ptr[6] = (stream->md_len >> 8) & 0xff;
+  ptr[7] = (stream->md_len >> 0) & 0xff;
+
+  ptr = put32(&ptr[8], stream->freerate);
+  ptr = put32(ptr, decoder->sync->timer.seconds);
+  ptr = put32(ptr, decoder->sync->timer.fraction);
+  ptr = put32(ptr, (unsigned long) (stream->samples >> 16 >> 16));
+  ptr = put32(ptr, (unsigned long) stream->samples);
+
+  if (stream->md_len) {
+    memcpy(ptr, *stream->main_data, stream->md_len);
+    ptr += stream->md_len;
+  }
+
+  value = &synth->filter[0][0][0][0][0];
+  for (i = 0; i < SNAPSHOT_FILTER; ++i)
+    ptr = put32(ptr, value[i]);
+
+  if (frame->overlap) {
+    value = &(*frame->overlap)[0][0][0];
+    for (i = 0; i < SNAPSHOT_OVERLAP_LEN; ++i)
+      ptr = put32(ptr, value[i]);
+  }
+
+  return 0;
+# endif
+}
+
+/*
+ * NAME:	decoder->restore()
+ * DESCRIPTION:	resume from a snapshot, now if decoding or else once the
+ *		decoder is run (the snapshot must remain valid until then)
+ */
+int mad_decoder_restore(struct mad_decoder *decoder,
+			void const *snapshot, unsigned int len)
+{
+# if defined(FPM_FLOAT)
+  (void) decoder;
+  (void) snapshot;
+  (void) len;
+
+  return -1;
+# else
+  if (snapshot_size(snapshot, len) == 0)
+    return -1;
+
+  if (decoder->sync &&
+      !(decoder->mode == MAD_DECODER_MODE_ASYNC && decoder->async.pid))
+    return restore_sync(decoder, snapshot, len);
+
+  decoder->restore.data   = snapshot;
+  decoder->restore.length = len;
+
+  return 0;
+# endif
+}
+
 /*
  * NAME:	decoder->message()
  * DESCRIPTION:	send a message to and receive a reply from the decoder process
@@ -580,3 +1176,19 @@ int mad_decoder_message(struct mad_decoder *decoder,
   return -1;
 # endif
 }
+
+/*
+ * NAME:	decoder->stats()
+ * DESCRIPTION:	copy the decoder's per-stage timing statistics
+ */
+int mad_decoder_stats(struct mad_decoder const *decoder,
+		      struct mad_stats *stats)
+{
+  *stats = decoder->stats;
+
+# if defined(OPT_STATS)
+  return 0;
+# else
+  return -1;
+# endif
+}
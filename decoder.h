@@ -25,6 +25,8 @@
 # include "stream.h"
 # include "frame.h"
 # include "synth.h"
+# include "bands.h"
+# include "gain.h"
 
 enum mad_decoder_mode {
   MAD_DECODER_MODE_SYNC  = 0,
@@ -38,10 +40,42 @@ enum mad_flow {
   MAD_FLOW_IGNORE   = 0x0020	/* ignore the current frame */
 };
 
+enum mad_stage {
+  MAD_STAGE_HEADER = 0,		/* frame header */
+  MAD_STAGE_CRC,		/* CRC check */
+  MAD_STAGE_SIDEINFO,		/* side info, bit allocation, bit reservoir */
+  MAD_STAGE_SCALEFACTORS,	/* scalefactors */
+  MAD_STAGE_HUFFMAN,		/* Layer III Huffman decoding, requantization */
+  MAD_STAGE_REQUANTIZE,		/* Layer I/II sample requantization */
+  MAD_STAGE_STEREO,		/* Layer III joint stereo */
+  MAD_STAGE_ALIAS,		/* Layer III reordering, alias reduction */
+  MAD_STAGE_IMDCT,		/* Layer III IMDCT, overlap-add, inversion */
+  MAD_STAGE_SYNTH,		/* synthesis matrixing and windowing */
+  MAD_STAGE_OUTPUT,		/* output callback */
+
+  MAD_NSTAGES
+};
+
+# if defined(_MSC_VER)
+typedef unsigned __int64 mad_nsec_t;
+# elif defined(__GNUC__) ||  \
+      (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L)
+typedef unsigned long long mad_nsec_t;
+# else
+typedef unsigned long mad_nsec_t;
+# endif
+
+struct mad_stats {
+  unsigned long frames;			/* frames synthesized */
+  mad_nsec_t nsec[MAD_NSTAGES];		/* time spent in each stage */
+};
+
 struct mad_decoder {
   enum mad_decoder_mode mode;
 
   int options;
+  struct mad_allocator const *allocator;
+  struct mad_gain *gain;		/* subband gains, if any */
 
   struct {
     long pid;
@@ -53,8 +87,16 @@ struct mad_decoder {
     struct mad_stream stream;
     struct mad_frame frame;
     struct mad_synth synth;
+    mad_timer_t timer;
   } *sync;
 
+  struct {
+    void const *data;
+    unsigned int length;
+  } restore;
+
+  struct mad_stats stats;		/* stage timing (with OPT_STATS) */
+
   void *cb_data;
 
   enum mad_flow (*input_func)(void *, struct mad_stream *);
@@ -65,6 +107,9 @@ struct mad_decoder {
 			       struct mad_header const *, struct mad_pcm *);
   enum mad_flow (*error_func)(void *, struct mad_stream *, struct mad_frame *);
   enum mad_flow (*message_func)(void *, void *, unsigned int *);
+
+  enum mad_flow (*bands_func)(void *, struct mad_header const *,
+			      struct mad_bands const *);
 };
 
 void mad_decoder_init(struct mad_decoder *, void *,
@@ -85,7 +130,24 @@ int mad_decoder_finish(struct mad_decoder *);
 # define mad_decoder_options(decoder, opts)  \
     ((void) ((decoder)->options = (opts)))
 
+# define mad_decoder_allocator(decoder, alloc)  \
+    ((void) ((decoder)->allocator = (alloc)))
+
+# define mad_decoder_gain(decoder, g)  \
+    ((void) ((decoder)->gain = (g)))
+
+/* with a bands callback, frames are analyzed instead of synthesized */
+# define mad_decoder_bands(decoder, func)  \
+    ((void) ((decoder)->bands_func = (func)))
+
 int mad_decoder_run(struct mad_decoder *, enum mad_decoder_mode);
 int mad_decoder_message(struct mad_decoder *, void *, unsigned int *);
 
+int mad_decoder_snapshot(struct mad_decoder *, void *, unsigned int *);
+int mad_decoder_restore(struct mad_decoder *, void const *, unsigned int);
+
+int mad_decoder_batch(struct mad_decoder *, unsigned int, unsigned int, int *);
+
+int mad_decoder_stats(struct mad_decoder const *, struct mad_stats *);
+
 # endif
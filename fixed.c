@@ -42,6 +42,9 @@ mad_fixed_t mad_f_abs(mad_fixed_t x)
  */
 mad_fixed_t mad_f_div(mad_fixed_t x, mad_fixed_t y)
 {
+# if defined(FPM_FLOAT)
+  return x / y;
+# else
   mad_fixed_t q, r;
   unsigned int bits;
 
@@ -78,4 +81,5 @@ mad_fixed_t mad_f_div(mad_fixed_t x, mad_fixed_t y)
     q = -q;
 
   return q << bits;
+# endif
 }
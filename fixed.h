@@ -28,7 +28,12 @@
 #  define INT_MAX 2147483647
 # endif
 
-# if INT_MAX >= 2147483647
+# if defined(FPM_FLOAT)
+typedef double mad_fixed_t;
+
+typedef double mad_fixed64hi_t;
+typedef double mad_fixed64lo_t;
+# elif INT_MAX >= 2147483647
 typedef   signed int mad_fixed_t;
 
 typedef   signed int mad_fixed64hi_t;
@@ -115,10 +120,32 @@ typedef mad_fixed_t mad_sample_t;
 # define mad_f_sub(x, y)	((x) - (y))
 
 # if defined(FPM_FLOAT)
-#  error "FPM_FLOAT not yet supported"
 
+/*
+ * This version is not fixed-point at all: values are doubles with the same
+ * scale (1.0 == MAD_F_ONE), and the decoding tables are computed when a
+ * frame or synth is first initialized. It is much slower than the other
+ * versions and is meant to serve as a reference for their accuracy.
+ */
 #  undef MAD_F
-#  define MAD_F(x)		mad_f_todouble(x)
+#  define MAD_F(x)		((mad_fixed_t) (x##L) / (1L << 28))
+
+#  undef MAD_F_MIN
+#  undef MAD_F_MAX
+#  define MAD_F_MIN		MAD_F(-0x80000000)
+#  define MAD_F_MAX		MAD_F(+0x7fffffff)
+
+#  undef mad_f_tofixed
+#  undef mad_f_todouble
+#  define mad_f_tofixed(x)	((mad_fixed_t) (x))
+#  define mad_f_todouble(x)	((double) (x))
+
+#  undef mad_f_intpart
+#  undef mad_f_fracpart
+#  undef mad_f_fromint
+#  define mad_f_intpart(x)	((long) (x))
+#  define mad_f_fracpart(x)	((x) - (long) (x))
+#  define mad_f_fromint(x)	((mad_fixed_t) (x))
 
 #  define mad_f_mul(x, y)	((x) * (y))
 #  define mad_f_scale64
@@ -33,6 +33,9 @@
 # include "timer.h"
 # include "layer12.h"
 # include "layer3.h"
+# include "pool.h"
+# include "alloc.h"
+# include "stats.h"
 
 static
 unsigned long const bitrate_table[5][15] = {
@@ -54,6 +57,11 @@ unsigned long const bitrate_table[5][15] = {
 static
 unsigned int const samplerate_table[3] = { 44100, 48000, 32000 };
 
+static
+unsigned short const fl_table[3][3][3][15] = {
+# include "fl_table.dat"
+};
+
 static
 int (*const decoder_table[3])(struct mad_stream *, struct mad_frame *) = {
   mad_layer_I,
@@ -95,7 +103,21 @@ void mad_frame_init(struct mad_frame *frame)
   frame->options = 0;
 
   frame->overlap = 0;
+  frame->pool    = 0;
+
+  frame->granule_func = 0;
+  frame->granule_data = 0;
+
+  frame->backend = 0;
+
+  frame->gain = 0;
+
   mad_frame_mute(frame);
+
+# if defined(FPM_FLOAT)
+  mad_layer12_init_tables();
+  mad_layer3_init_tables();
+# endif
 }
 
 /*
@@ -107,9 +129,19 @@ void mad_frame_finish(struct mad_frame *frame)
   mad_header_finish(&frame->header);
 
   if (frame->overlap) {
-    free(frame->overlap);
+    mad_free(frame->overlap);
     frame->overlap = 0;
   }
+
+  if (frame->pool) {
+    mad_pool_destroy(frame->pool);
+    frame->pool = 0;
+  }
+
+  if (frame->backend) {
+    mad_free(frame->backend);
+    frame->backend = 0;
+  }
 }
 
 /*
@@ -117,9 +149,12 @@ void mad_frame_finish(struct mad_frame *frame)
  * DESCRIPTION:	read header data and following CRC word
  */
 static
-int decode_header(struct mad_header *header, struct mad_stream *stream)
+int decode_header(struct mad_header *header, struct mad_stream *stream,
+		  unsigned int *length)
 {
-  unsigned int index;
+  unsigned char const *ptr;
+  unsigned long bits;
+  unsigned int version, index;
   struct mad_bitptr bufend_ptr;
 
   header->flags        = 0;
@@ -133,92 +168,100 @@ int decode_header(struct mad_header *header, struct mad_stream *stream)
     return -1;
   }
 
-  /* syncword */
-  mad_bit_skip(&stream->ptr, 11);
+  /* the header always begins on a byte boundary; load it at once */
 
-  /* MPEG 2.5 indicator (really part of syncword) */
-  if (mad_bit_read(&stream->ptr, 1) == 0)
-    header->flags |= MAD_FLAG_MPEG_2_5_EXT;
+  ptr  = mad_bit_nextbyte(&stream->ptr);
+  bits = ((unsigned long) ptr[0] << 24) | ((unsigned long) ptr[1] << 16) |
+         ((unsigned long) ptr[2] <<  8) | ((unsigned long) ptr[3] <<  0);
 
-  /* ID */
-  if (mad_bit_read(&stream->ptr, 1) == 0)
-    header->flags |= MAD_FLAG_LSF_EXT;
-  else if (header->flags & MAD_FLAG_MPEG_2_5_EXT) {
+  mad_bit_skip(&stream->ptr, 32);
+
+  /* MPEG 2.5 indicator (really part of syncword) and ID */
+  switch ((bits >> 19) & 0x3) {
+  case 0:
+    header->flags |= MAD_FLAG_LSF_EXT | MAD_FLAG_MPEG_2_5_EXT;
+    version = 2;
+    break;
+  case 1:
     stream->error = MAD_ERROR_LOSTSYNC;
     return -1;
+  case 2:
+    header->flags |= MAD_FLAG_LSF_EXT;
+    version = 1;
+    break;
+  default:
+    version = 0;
   }
 
   /* layer */
-  header->layer = 4 - mad_bit_read(&stream->ptr, 2);
+  header->layer = 4 - ((bits >> 17) & 0x3);
 
-  switch (header->layer) {
-  case MAD_LAYER_I: case MAD_LAYER_II: case MAD_LAYER_III:
-    break;
-  default:
+  if (header->layer == 4) {
     stream->error = MAD_ERROR_BADLAYER;
     return -1;
   }
 
   /* protection_bit */
-  if (mad_bit_read(&stream->ptr, 1) == 0) {
+  if ((bits & 0x00010000UL) == 0) {
+    struct mad_bitptr crc_ptr;
+
+    /* the CRC covers the header from bitrate_index to emphasis */
+    mad_bit_init(&crc_ptr, ptr + 2);
+
     header->flags    |= MAD_FLAG_PROTECTION;
-    header->crc_check = mad_bit_crc(stream->ptr, 16, 0xffff);
+    header->crc_check = mad_bit_crc(crc_ptr, 16, 0xffff);
   }
 
   /* bitrate_index */
-  index = mad_bit_read(&stream->ptr, 4);
+  index = (bits >> 12) & 0xf;
 
   if (index == 15) {
     stream->error = MAD_ERROR_BADBITRATE;
     return -1;
   }
 
-  if (header->flags & MAD_FLAG_LSF_EXT)
-    header->bitrate = bitrate_table[3 + (header->layer >> 1)][index];
-  else
-    header->bitrate = bitrate_table[header->layer - 1][index];
+  header->bitrate = version ?
+    bitrate_table[3 + (header->layer >> 1)][index] :
+    bitrate_table[header->layer - 1][index];
 
   /* sampling_frequency */
-  index = mad_bit_read(&stream->ptr, 2);
-
-  if (index == 3) {
+  if (((bits >> 10) & 0x3) == 3) {
     stream->error = MAD_ERROR_BADSAMPLERATE;
     return -1;
   }
 
-  header->samplerate = samplerate_table[index];
-
-  if (header->flags & MAD_FLAG_LSF_EXT) {
-    header->samplerate /= 2;
+  /* each extension halves the MPEG-1 sampling frequency */
+  header->samplerate = samplerate_table[(bits >> 10) & 0x3] >> version;
 
-    if (header->flags & MAD_FLAG_MPEG_2_5_EXT)
-      header->samplerate /= 2;
-  }
+  /* frame length, less padding (0 for free format) */
+  *length = fl_table[version][header->layer - 1][(bits >> 10) & 0x3][index];
 
   /* padding_bit */
-  if (mad_bit_read(&stream->ptr, 1))
+  if (bits & 0x00000200UL) {
     header->flags |= MAD_FLAG_PADDING;
+    *length += (header->layer == MAD_LAYER_I) ? 4 : 1;
+  }
 
   /* private_bit */
-  if (mad_bit_read(&stream->ptr, 1))
+  if (bits & 0x00000100UL)
     header->private_bits |= MAD_PRIVATE_HEADER;
 
   /* mode */
-  header->mode = 3 - mad_bit_read(&stream->ptr, 2);
+  header->mode = 3 - ((bits >> 6) & 0x3);
 
   /* mode_extension */
-  header->mode_extension = mad_bit_read(&stream->ptr, 2);
+  header->mode_extension = (bits >> 4) & 0x3;
 
   /* copyright */
-  if (mad_bit_read(&stream->ptr, 1))
+  if (bits & 0x00000008UL)
     header->flags |= MAD_FLAG_COPYRIGHT;
 
   /* original/copy */
-  if (mad_bit_read(&stream->ptr, 1))
+  if (bits & 0x00000004UL)
     header->flags |= MAD_FLAG_ORIGINAL;
 
   /* emphasis */
-  header->emphasis = mad_bit_read(&stream->ptr, 2);
+  header->emphasis = bits & 0x3;
 
 # if defined(OPT_STRICT)
   /*
@@ -246,6 +289,56 @@ int decode_header(struct mad_header *header, struct mad_stream *stream)
   return 0;
 }
 
+/*
+ * NAME:	frame_length()
+ * DESCRIPTION:	return the length in bytes of a frame at the given bitrate
+ */
+static
+unsigned int frame_length(struct mad_header const *header,
+			  unsigned long bitrate)
+{
+  unsigned int pad_slot, slots_per_frame;
+
+  pad_slot = (header->flags & MAD_FLAG_PADDING) ? 1 : 0;
+
+  if (header->layer == MAD_LAYER_I)
+    return ((12 * bitrate / header->samplerate) + pad_slot) * 4;
+
+  slots_per_frame = (header->layer == MAD_LAYER_III &&
+		     (header->flags & MAD_FLAG_LSF_EXT)) ? 72 : 144;
+
+  return (slots_per_frame * bitrate / header->samplerate) + pad_slot;
+}
+
+/*
+ * NAME:	free_cached()
+ * DESCRIPTION:	check whether the known free bitrate still frames the stream
+ */
+static
+int free_cached(struct mad_stream const *stream,
+		struct mad_header const *header)
+{
+  unsigned char const *this, *next;
+  unsigned int N;
+
+  this = stream->this_frame;
+  N    = frame_length(header, stream->freerate);
+
+  if (stream->bufend - this < N + 3)
+    return 0;
+
+  next = this + N;
+
+  /*
+   * The next frame must be free format with the same version, layer, and
+   * sampling frequency; only its protection and padding bits may differ.
+   */
+
+  return next[0] == 0xff &&
+    (next[1] & 0xfe) == (this[1] & 0xfe) &&
+    (next[2] & 0xfc) == (this[2] & 0xfc);
+}
+
 /*
  * NAME:	free_bitrate()
  * DESCRIPTION:	attempt to discover the bitstream's free bitrate
@@ -255,23 +348,47 @@ int free_bitrate(struct mad_stream *stream, struct mad_header const *header)
 {
   struct mad_bitptr keep_ptr;
   unsigned long rate = 0;
-  unsigned int pad_slot, slots_per_frame;
-  unsigned char const *ptr = 0;
+  unsigned int pad_slot, slots_per_frame, window;
+  unsigned char const *ptr = 0, *keep_end;
 
   keep_ptr = stream->ptr;
+  keep_end = stream->bufend;
 
   pad_slot = (header->flags & MAD_FLAG_PADDING) ? 1 : 0;
   slots_per_frame = (header->layer == MAD_LAYER_III &&
 		     (header->flags & MAD_FLAG_LSF_EXT)) ? 72 : 144;
 
+  /*
+   * For Layer III, only probe as far as the next frame could begin at 640
+   * kbps, the highest free bitrate it accepts. Layer I and II free format
+   * streams have no such limit, so the whole buffer is searched for them.
+   */
+
+  if (header->layer == MAD_LAYER_III) {
+    window = frame_length(header, 640000) + 4 + MAD_BUFFER_GUARD;
+    if (stream->bufend - stream->this_frame > window)
+      stream->bufend = stream->this_frame + window;
+  }
+
   while (mad_stream_sync(stream) == 0) {
     struct mad_stream peek_stream;
     struct mad_header peek_header;
+    unsigned int peek_length;
+
+    ptr = mad_bit_nextbyte(&stream->ptr);
+
+    /* cheaply pass over sync words of another layer or sampling frequency */
+
+    if ((ptr[1] & 0x1e) != (stream->this_frame[1] & 0x1e) ||
+	(ptr[2] & 0x0c) != (stream->this_frame[2] & 0x0c)) {
+      mad_bit_skip(&stream->ptr, 8);
+      continue;
+    }
 
     peek_stream = *stream;
     peek_header = *header;
 
-    if (decode_header(&peek_header, &peek_stream) == 0 &&
+    if (decode_header(&peek_header, &peek_stream, &peek_length) == 0 &&
 	peek_header.layer == header->layer &&
 	peek_header.samplerate == header->samplerate) {
       unsigned int N;
@@ -296,7 +413,8 @@ int free_bitrate(struct mad_stream *stream, struct mad_header const *header)
     mad_bit_skip(&stream->ptr, 8);
   }
 
-  stream->ptr = keep_ptr;
+  stream->ptr    = keep_ptr;
+  stream->bufend = keep_end;
 
   if (rate < 8 || (header->layer == MAD_LAYER_III && rate > 640)) {
     stream->error = MAD_ERROR_LOSTSYNC;
@@ -315,7 +433,10 @@ int free_bitrate(struct mad_stream *stream, struct mad_header const *header)
 int mad_header_decode(struct mad_header *header, struct mad_stream *stream)
 {
   register unsigned char const *ptr, *end;
-  unsigned int pad_slot, N;
+  unsigned int N;
+  STATS_LAP_DECL(lap)
+
+  STATS_LAP_START(lap, stream->stats);
 
   ptr = stream->next_frame;
   end = stream->bufend;
@@ -384,36 +505,27 @@ int mad_header_decode(struct mad_header *header, struct mad_stream *stream)
 
   mad_bit_init(&stream->ptr, stream->this_frame);
 
-  if (decode_header(header, stream) == -1)
+  if (decode_header(header, stream, &N) == -1)
     goto fail;
 
-  /* calculate frame duration */
-  mad_timer_set(&header->duration, 0,
-		32 * MAD_NSBSAMPLES(header), header->samplerate);
+  /* calculate frame duration (exact for every MPEG sample rate) */
+  header->duration.seconds  = 0;
+  header->duration.fraction = 32 * MAD_NSBSAMPLES(header) *
+    (MAD_TIMER_RESOLUTION / header->samplerate);
 
   /* calculate free bit rate */
   if (header->bitrate == 0) {
-    if ((stream->freerate == 0 || !stream->sync ||
+    if ((stream->freerate == 0 ||
+	 (!stream->sync && !free_cached(stream, header)) ||
 	 (header->layer == MAD_LAYER_III && stream->freerate > 640000)) &&
 	free_bitrate(stream, header) == -1)
       goto fail;
 
     header->bitrate = stream->freerate;
     header->flags  |= MAD_FLAG_FREEFORMAT;
-  }
 
-  /* calculate beginning of next frame */
-  pad_slot = (header->flags & MAD_FLAG_PADDING) ? 1 : 0;
-
-  if (header->layer == MAD_LAYER_I)
-    N = ((12 * header->bitrate / header->samplerate) + pad_slot) * 4;
-  else {
-    unsigned int slots_per_frame;
-
-    slots_per_frame = (header->layer == MAD_LAYER_III &&
-		       (header->flags & MAD_FLAG_LSF_EXT)) ? 72 : 144;
-
-    N = (slots_per_frame * header->bitrate / header->samplerate) + pad_slot;
+    /* calculate beginning of next frame */
+    N = frame_length(header, header->bitrate);
   }
 
   /* verify there is enough data left in buffer to decode this frame */
@@ -438,13 +550,19 @@ int mad_header_decode(struct mad_header *header, struct mad_stream *stream)
     stream->sync = 1;
   }
 
+  stream->samples += 32 * MAD_NSBSAMPLES(header);
+
   header->flags |= MAD_FLAG_INCOMPLETE;
 
+  STATS_LAP(lap, MAD_STAGE_HEADER);
+
   return 0;
 
  fail:
   stream->sync = 0;
 
+  STATS_LAP(lap, MAD_STAGE_HEADER);
+
   return -1;
 }
 
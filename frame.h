@@ -26,6 +26,10 @@
 # include "timer.h"
 # include "stream.h"
 
+struct mad_pool;
+struct mad_backend;
+struct mad_gain;
+
 enum mad_layer {
   MAD_LAYER_I   = 1,			/* Layer I */
   MAD_LAYER_II  = 2,			/* Layer II */
@@ -71,6 +75,15 @@ struct mad_frame {
 
   mad_fixed_t sbsample[2][36][32];	/* synthesis subband filter samples */
   mad_fixed_t (*overlap)[2][32][18];	/* Layer III block overlap data */
+
+  struct mad_pool *pool;		/* Layer III worker thread, if any */
+
+  void (*granule_func)(void *, struct mad_frame *, unsigned int);
+  void *granule_data;			/* Layer III granule callback, if any */
+
+  struct mad_backend *backend;		/* deferred Layer III back end, if any */
+
+  struct mad_gain *gain;		/* subband gains, if any */
 };
 
 # define MAD_NCHANNELS(header)		((header)->mode ? 2 : 1)
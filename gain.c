@@ -0,0 +1,188 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * $Id$
+ */
+
+# ifdef HAVE_CONFIG_H
+#  include "config.h"
+# endif
+
+# include "global.h"
+
+# include "fixed.h"
+# include "gain.h"
+
+/*
+ * Subband gains scale each of the 32 subbands of each channel while a
+ * frame is decoded, so that equalization and replay gain need no pass of
+ * their own over the subband samples: Layer I and II fold the gains into
+ * their scalefactors, and Layer III applies them as the IMDCT output is
+ * overlapped. A new set of gains can be reached gradually; the gains then
+ * change by equal steps once per block of 12 subband samples (Layer I and
+ * II) or 18 (Layer III).
+ */
+
+/*
+ * NAME:	limit()
+ * DESCRIPTION:	return the largest magnitude whose product with a gain
+ *		need not be saturated
+ */
+static
+mad_fixed_t limit(mad_fixed_t gain)
+{
+  if (gain <= MAD_F_ONE)
+    return MAD_F_MAX;
+
+  return mad_f_div(MAD_GAIN_CEIL, gain);
+}
+
+/*
+ * NAME:	update()
+ * DESCRIPTION:	recompute the saturation limits of the current gains
+ */
+static
+void update(struct mad_gain_block *block)
+{
+  unsigned int ch, sb;
+
+  for (ch = 0; ch < 2; ++ch) {
+    for (sb = 0; sb < 32; ++sb)
+      block->limit[ch][sb] = limit(block->gain[ch][sb]);
+  }
+}
+
+/*
+ * NAME:	unity()
+ * DESCRIPTION:	return whether all gains of a set are exactly 1
+ */
+static
+int unity(mad_fixed_t const gains[2][32])
+{
+  unsigned int ch, sb;
+
+  for (ch = 0; ch < 2; ++ch) {
+    for (sb = 0; sb < 32; ++sb) {
+      if (gains[ch][sb] != MAD_F_ONE)
+	return 0;
+    }
+  }
+
+  return 1;
+}
+
+/*
+ * NAME:	gain->init()
+ * DESCRIPTION:	initialize gain struct with all gains 1
+ */
+void mad_gain_init(struct mad_gain *gain)
+{
+  unsigned int ch, sb;
+
+  for (ch = 0; ch < 2; ++ch) {
+    for (sb = 0; sb < 32; ++sb) {
+      gain->target[ch][sb]  = MAD_F_ONE;
+      gain->delta[ch][sb]   = 0;
+
+      gain->current.gain[ch][sb]  = MAD_F_ONE;
+      gain->current.limit[ch][sb] = MAD_F_MAX;
+    }
+  }
+
+  gain->ramp  = 0;
+  gain->unity = 1;
+}
+
+/*
+ * NAME:	gain->set()
+ * DESCRIPTION:	request new gains [ch][sb] (0 to MAD_GAIN_MAX), reached
+ *		linearly over the given number of subband samples
+ */
+void mad_gain_set(struct mad_gain *gain, mad_fixed_t const target[2][32],
+		  unsigned int ramp)
+{
+  unsigned int ch, sb;
+  mad_fixed_t value;
+
+  for (ch = 0; ch < 2; ++ch) {
+    for (sb = 0; sb < 32; ++sb) {
+      value = target[ch][sb];
+      if (value < 0)
+	value = 0;
+      else if (value > MAD_GAIN_MAX)
+	value = MAD_GAIN_MAX;
+
+      gain->target[ch][sb] = value;
+
+      if (ramp)
+	gain->delta[ch][sb] =
+	  (value - gain->current.gain[ch][sb]) / (signed int) ramp;
+      else {
+	gain->current.gain[ch][sb] = value;
+	gain->delta[ch][sb]        = 0;
+      }
+    }
+  }
+
+  if (ramp == 0)
+    update(&gain->current);
+
+  gain->ramp  = ramp;
+  gain->unity = unity(gain->target) && unity(gain->current.gain);
+}
+
+/*
+ * NAME:	gain->step()
+ * DESCRIPTION:	advance the gains by a block of ns subband samples; return
+ *		the gains and their limits for the block, or 0 if all are 1
+ */
+struct mad_gain_block const *mad_gain_step(struct mad_gain *gain,
+					   unsigned int ns)
+{
+  unsigned int ch, sb;
+
+  if (gain->unity)
+    return 0;
+
+  if (gain->ramp > ns) {
+    for (ch = 0; ch < 2; ++ch) {
+      for (sb = 0; sb < 32; ++sb)
+	gain->current.gain[ch][sb] += gain->delta[ch][sb] * (signed int) ns;
+    }
+
+    update(&gain->current);
+
+    gain->ramp -= ns;
+  }
+  else if (gain->ramp) {
+    for (ch = 0; ch < 2; ++ch) {
+      for (sb = 0; sb < 32; ++sb)
+	gain->current.gain[ch][sb] = gain->target[ch][sb];
+    }
+
+    update(&gain->current);
+
+    gain->ramp  = 0;
+    gain->unity = unity(gain->target);
+
+    if (gain->unity)
+      return 0;
+  }
+
+  return &gain->current;
+}
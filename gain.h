@@ -0,0 +1,66 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * $Id$
+ */
+
+# ifndef LIBMAD_GAIN_H
+# define LIBMAD_GAIN_H
+
+# include "fixed.h"
+
+/* largest subband gain (just under +12 dB) */
+# define MAD_GAIN_MAX		MAD_F(0x3fffffff)
+
+struct mad_gain_block {
+  mad_fixed_t gain[2][32];		/* gains of a block [ch][sb] */
+  mad_fixed_t limit[2][32];		/* largest unsaturated samples */
+};
+
+struct mad_gain {
+  mad_fixed_t target[2][32];		/* requested gains [ch][sb] */
+  mad_fixed_t delta[2][32];		/* change per subband sample */
+  struct mad_gain_block current;	/* gains now applied */
+
+  unsigned int ramp;			/* subband samples left to ramp */
+  int unity;				/* all gains are exactly 1 */
+};
+
+void mad_gain_init(struct mad_gain *);
+
+# define mad_gain_finish(gain)  /* nothing */
+
+void mad_gain_set(struct mad_gain *, mad_fixed_t const [2][32],
+		  unsigned int);
+
+struct mad_gain_block const *mad_gain_step(struct mad_gain *, unsigned int);
+
+/*
+ * Gained products saturate at +/- MAD_GAIN_CEIL rather than wrapping. The
+ * range is symmetric, so that a saturated sample can still be negated, and
+ * slightly inside that of mad_fixed_t, so that no mad_f_mul() rounding can
+ * carry a product past it.
+ */
+# define MAD_GAIN_CEIL		(MAD_F_MAX - MAD_F_MAX / 4096)
+
+/* product of a sample and a gain, saturated using the gain's limit */
+# define mad_gain_mul(x, gain, limit)  \
+    ((x) >  (limit) ?  MAD_GAIN_CEIL :  \
+     (x) < -(limit) ? -MAD_GAIN_CEIL : mad_f_mul((x), (gain)))
+
+# endif
@@ -38,15 +38,31 @@
 #  error "cannot optimize for both speed and accuracy"
 # endif
 
-# if defined(OPT_SPEED) && !defined(OPT_SSO)
+# if defined(OPT_SPEED) && !defined(OPT_SSO) && !defined(FPM_FLOAT)
 #  define OPT_SSO
 # endif
 
+# if defined(FPM_FLOAT) && defined(OPT_SSO)
+#  error "OPT_SSO cannot be used with FPM_FLOAT"
+# endif
+
+/* tables that FPM_FLOAT computes at run time cannot be const */
+
+# if defined(FPM_FLOAT)
+#  define TABLE_CONST	/* nothing */
+# else
+#  define TABLE_CONST	const
+# endif
+
 # if defined(HAVE_UNISTD_H) && defined(HAVE_WAITPID) &&  \
     defined(HAVE_FCNTL) && defined(HAVE_PIPE) && defined(HAVE_FORK)
 #  define USE_ASYNC
 # endif
 
+# if defined(HAVE_PTHREAD_H) && defined(HAVE_PTHREAD_CREATE)
+#  define USE_THREADS
+# endif
+
 # if !defined(HAVE_ASSERT_H)
 #  if defined(NDEBUG)
 #   define assert(x)	/* nothing */
@@ -0,0 +1,536 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * $Id$
+ */
+
+/*
+ * These are the libmad kernel microbenchmarks. The decoding kernels are
+ * static, so the library sources are included here directly; `make kbench'
+ * compiles this file once for each fixed-point math variant the host
+ * supports, and each build uses its own FPM_* selection throughout.
+ *
+ * Kernel inputs are realistic: Layer III granules are captured from the
+ * III-mpeg1-joint stream of the benchmark corpus (see corpus.c), and the
+ * subband samples for the synthesis kernels come from decoding it.
+ *
+ * Each kernel runs until the minimum time has elapsed, and the results are
+ * written to standard output as JSON. The checksum of each kernel's output
+ * over all inputs shows whether two builds compute the same thing.
+ *
+ * Usage: mad-kbench-FPM [-t seconds]
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <sys/time.h>
+
+# include "version.c"
+# include "fixed.c"
+# include "bit.c"
+# include "timer.c"
+# include "stream.c"
+# include "frame.c"
+# include "layer12.c"
+# include "layer3.c"
+# include "huffman.c"
+# include "pool.c"
+# include "alloc.c"
+# include "stats.c"
+# include "gain.c"
+
+/* synth.c redefines MAD_F_SCALEBITS for its own use, so it must come last */
+# include "synth.c"
+
+# include "corpus.h"
+
+# define NFRAMES	64
+# define NGRANULES	(NFRAMES * 2 * 2)
+
+/* a granule's Huffman-coded data, ready for III_huffdecode() */
+struct capture {
+  struct channel channel;
+  unsigned char const *sfbwidth;
+  struct mad_bitptr ptr;
+  unsigned int part3_length;
+};
+
+static struct capture captures[NGRANULES];
+static unsigned int ncaptures;
+
+static mad_fixed_t spectra[NGRANULES][576];	/* requantized granules */
+static mad_fixed_t scratch[NGRANULES][576];	/* scratch copy of the above */
+
+static struct mad_frame frames[NFRAMES];	/* decoded subband samples */
+static unsigned int nframes;
+
+static struct mad_synth synth;
+static struct mad_synth streams[4];		/* for mad_synth_frame_multi() */
+static mad_fixed_t output[36];
+static mad_fixed_t lo[16][8], hi[16][8];
+
+static int verify;
+static unsigned long checksum;
+
+/*
+ * NAME:	fold()
+ * DESCRIPTION:	accumulate kernel output into the checksum
+ */
+static
+void fold(mad_fixed_t const *x, unsigned int n)
+{
+  while (n--)
+    checksum = (checksum * 31 + (unsigned long) *x++) & 0xffffffffUL;
+}
+
+/*
+ * NAME:	capture()
+ * DESCRIPTION:	collect Layer III granules and subband samples from a stream
+ */
+static
+int capture(unsigned char const *data, unsigned long length)
+{
+  struct mad_stream stream;
+  struct mad_header header;
+  struct mad_frame frame;
+  unsigned char *md, *base;
+  unsigned long md_len = 0;
+
+  md = malloc(length);
+  if (md == 0)
+    return -1;
+
+  /* granules: side info, main data, scalefactors */
+
+  mad_stream_init(&stream);
+  mad_header_init(&header);
+  mad_stream_buffer(&stream, data, length);
+
+  while (ncaptures + 4 <= NGRANULES) {
+    struct sideinfo si;
+    struct mad_bitptr ptr;
+    unsigned int nch, lsf, sfreq, sfreqi, ngr, gr, ch;
+    unsigned int data_bitlen, priv_bitlen;
+    unsigned char const *slot;
+
+    if (mad_header_decode(&header, &stream) == -1) {
+      if (!MAD_RECOVERABLE(stream.error))
+	break;
+      continue;
+    }
+
+    nch = MAD_NCHANNELS(&header);
+    lsf = (header.flags & MAD_FLAG_LSF_EXT) != 0;
+
+    ptr = stream.ptr;
+    if (III_sideinfo(&ptr, nch, lsf, &si, &data_bitlen, &priv_bitlen))
+      continue;
+
+    /* the main data of successive frames is contiguous once collected */
+
+    slot = mad_bit_nextbyte(&ptr);
+    base = md + md_len - si.main_data_begin;
+
+    memcpy(md + md_len, slot, stream.next_frame - slot);
+    md_len += stream.next_frame - slot;
+
+    if (si.main_data_begin > md_len)
+      continue;
+
+    sfreq = header.samplerate;
+    if (header.flags & MAD_FLAG_MPEG_2_5_EXT)
+      sfreq *= 2;
+
+    sfreqi = ((sfreq >>  7) & 0x000f) +
+             ((sfreq >> 15) & 0x0001) - 8;
+
+    if (header.flags & MAD_FLAG_MPEG_2_5_EXT)
+      sfreqi += 3;
+
+    mad_bit_init(&ptr, base);
+
+    ngr = lsf ? 1 : 2;
+
+    for (gr = 0; gr < ngr; ++gr) {
+      for (ch = 0; ch < nch; ++ch) {
+	struct channel *channel = &si.gr[gr].ch[ch];
+	struct capture *granule = &captures[ncaptures];
+	unsigned int part2_length;
+
+	granule->sfbwidth = sfbwidth_table[sfreqi].l;
+	if (channel->block_type == 2) {
+	  granule->sfbwidth = (channel->flags & mixed_block_flag) ?
+	    sfbwidth_table[sfreqi].m : sfbwidth_table[sfreqi].s;
+	}
+
+	if (lsf) {
+	  III_scalefactors_lsf(&ptr, channel, ch == 0 ? 0 : &si.gr[1].ch[1],
+			       header.mode_extension, channel->part2_3_length,
+			       &part2_length);
+	}
+	else {
+	  III_scalefactors(&ptr, channel, &si.gr[0].ch[ch],
+			   gr == 0 ? 0 : si.scfsi[ch], channel->part2_3_length,
+			   &part2_length);
+	}
+
+	granule->channel      = *channel;
+	granule->ptr          = ptr;
+	granule->part3_length = channel->part2_3_length - part2_length;
+
+	mad_bit_skip(&ptr, granule->part3_length);
+	++ncaptures;
+      }
+    }
+  }
+
+  mad_stream_finish(&stream);
+
+  /* subband samples */
+
+  mad_stream_init(&stream);
+  mad_frame_init(&frame);
+  mad_stream_buffer(&stream, data, length);
+
+  while (nframes < NFRAMES) {
+    if (mad_frame_decode(&frame, &stream) == -1) {
+      if (!MAD_RECOVERABLE(stream.error))
+	break;
+      continue;
+    }
+
+    memcpy(frames[nframes++].sbsample, frame.sbsample,
+	   sizeof(frame.sbsample));
+  }
+
+  mad_frame_finish(&frame);
+  mad_stream_finish(&stream);
+
+  return (ncaptures && nframes) ? 0 : -1;
+}
+
+/*
+ * NAME:	now()
+ * DESCRIPTION:	return the wall clock time in seconds
+ */
+static
+double now(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, 0);
+
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* --- Kernels ------------------------------------------------------------- */
+
+static
+void run_huffdecode(unsigned long n)
+{
+  unsigned long i;
+
+  for (i = 0; i < n; ++i) {
+    struct capture const *granule = &captures[i % ncaptures];
+    struct channel channel = granule->channel;
+    struct mad_bitptr ptr = granule->ptr;
+    mad_fixed_t *xr = spectra[i % ncaptures];
+
+    III_huffdecode(&ptr, xr, &channel, granule->sfbwidth,
+		   granule->part3_length);
+
+    if (verify)
+      fold(xr, 576);
+  }
+}
+
+static
+void run_aliasreduce(unsigned long n)
+{
+  unsigned long i;
+
+  /* alias reduction is in place; the butterflies keep the data bounded */
+
+  for (i = 0; i < n; ++i) {
+    mad_fixed_t *xr = scratch[i % ncaptures];
+
+    if (verify)
+      memcpy(xr, spectra[i % ncaptures], sizeof(scratch[0]));
+
+    III_aliasreduce(xr, 576);
+
+    if (verify)
+      fold(xr, 576);
+  }
+}
+
+# if !defined(ASO_IMDCT)
+static
+void run_imdct36(unsigned long n)
+{
+  unsigned long i, j;
+
+  for (i = 0; i < n; ++i) {
+    j = i % (ncaptures * 32);
+
+    imdct36(&spectra[j / 32][18 * (j % 32)], output);
+
+    if (verify)
+      fold(output, 36);
+  }
+}
+# endif
+
+static
+void run_imdct_l(unsigned long n)
+{
+  unsigned long i, j;
+
+  for (i = 0; i < n; ++i) {
+    j = i % (ncaptures * 32);
+
+    III_imdct_l(&spectra[j / 32][18 * (j % 32)], output, 0);
+
+    if (verify)
+      fold(output, 36);
+  }
+}
+
+static
+void run_imdct_s(unsigned long n)
+{
+  unsigned long i, j;
+
+  for (i = 0; i < n; ++i) {
+    j = i % (ncaptures * 32);
+
+    III_imdct_s(&spectra[j / 32][18 * (j % 32)], output);
+
+    if (verify)
+      fold(output, 36);
+  }
+}
+
+static
+void run_dct32(unsigned long n)
+{
+  unsigned long i, j;
+
+  for (i = 0; i < n; ++i) {
+    j = i % (nframes * 2 * 36);
+
+    dct32(frames[j / 72].sbsample[(j / 36) % 2][j % 36], i % 8, lo, hi);
+
+    if (verify) {
+      fold(&lo[0][0], 16 * 8);
+      fold(&hi[0][0], 16 * 8);
+    }
+  }
+}
+
+static
+void run_synth_full(unsigned long n)
+{
+  unsigned long i;
+
+  for (i = 0; i < n; ++i) {
+    synth_full(&synth, &frames[i % nframes], &synth.pcm, 2, 0, 36);
+
+    if (verify) {
+      fold(synth.pcm.samples[0], 32 * 36);
+      fold(synth.pcm.samples[1], 32 * 36);
+    }
+  }
+}
+
+static
+void run_synth_half(unsigned long n)
+{
+  unsigned long i;
+
+  for (i = 0; i < n; ++i) {
+    synth_half(&synth, &frames[i % nframes], &synth.pcm, 2, 0, 36);
+
+    if (verify) {
+      fold(synth.pcm.samples[0], 16 * 36);
+      fold(synth.pcm.samples[1], 16 * 36);
+    }
+  }
+}
+
+static
+void run_synth_multi(unsigned long n)
+{
+  struct mad_synth *synths[4];
+  struct mad_frame const *multi[4];
+  unsigned long i;
+  unsigned int k, count;
+
+  /* four stereo streams fill the eight lanes; each call is one frame */
+
+  for (i = 0; i < n; i += count) {
+    count = (n - i < 4) ? n - i : 4;
+
+    for (k = 0; k < count; ++k) {
+      synths[k] = &streams[k];
+      multi[k]  = &frames[(i + k) % nframes];
+    }
+
+    mad_synth_frame_multi(synths, multi, count);
+
+    if (verify) {
+      for (k = 0; k < count; ++k) {
+	fold(streams[k].pcm.samples[0], 32 * 36);
+	fold(streams[k].pcm.samples[1], 32 * 36);
+      }
+    }
+  }
+}
+
+static
+struct kernel {
+  char const *name;
+  char const *unit;		/* what one call processes */
+  void (*run)(unsigned long);
+} const kernels[] = {
+  /* III_huffdecode() comes first: it fills spectra[] for the others */
+  { "III_huffdecode",  "granule", run_huffdecode  },
+  { "III_aliasreduce", "granule", run_aliasreduce },
+# if !defined(ASO_IMDCT)
+  { "imdct36",         "subband", run_imdct36     },
+# endif
+  { "III_imdct_l",     "subband", run_imdct_l     },
+  { "III_imdct_s",     "subband", run_imdct_s     },
+  { "dct32",           "slot",    run_dct32       },
+  { "synth_full",      "frame",   run_synth_full  },
+  { "synth_half",      "frame",   run_synth_half  },
+  { "synth_multi",     "frame",   run_synth_multi }
+};
+
+# define NKERNELS	(sizeof(kernels) / sizeof(kernels[0]))
+
+/*
+ * NAME:	ninputs()
+ * DESCRIPTION:	return the number of distinct inputs for a kernel unit
+ */
+static
+unsigned long ninputs(char const *unit)
+{
+  if (strcmp(unit, "granule") == 0)
+    return ncaptures;
+  if (strcmp(unit, "subband") == 0)
+    return ncaptures * 32;
+  if (strcmp(unit, "slot") == 0)
+    return nframes * 2 * 36;
+
+  return nframes;
+}
+
+/*
+ * NAME:	measure()
+ * DESCRIPTION:	time a kernel over at least the given period
+ */
+static
+double measure(struct kernel const *kernel, double period,
+	       unsigned long *calls)
+{
+  unsigned long n;
+  double start, elapsed;
+
+  for (n = 64; ; n *= 2) {
+    start = now();
+    kernel->run(n);
+    elapsed = now() - start;
+
+    if (elapsed >= period || n >= 1UL << 30)
+      break;
+  }
+
+  *calls = n;
+
+  return elapsed;
+}
+
+int main(int argc, char *argv[])
+{
+  struct corpus_case const *tc = 0;
+  unsigned char *data;
+  unsigned long length, calls, inputs;
+  double period = 0.2, elapsed;
+  unsigned int i, j;
+
+  if (argc == 3 && strcmp(argv[1], "-t") == 0)
+    period = atof(argv[2]);
+  else if (argc != 1) {
+    fprintf(stderr, "usage: %s [-t seconds]\n", argv[0]);
+    return 1;
+  }
+
+  for (i = 0; i < corpus_size; ++i) {
+    if (strcmp(corpus[i].name, "III-mpeg1-joint") == 0)
+      tc = &corpus[i];
+  }
+
+  if (tc == 0 || (length = corpus_synthesize(tc, 2, &data)) == 0 ||
+      capture(data, length) == -1) {
+    fprintf(stderr, "%s: cannot prepare kernel inputs\n", argv[0]);
+    return 2;
+  }
+
+  printf("{\n");
+  printf("  \"build\": \"%s\",\n", mad_build);
+  printf("  \"kernels\": [");
+
+  for (i = 0; i < NKERNELS; ++i) {
+    struct kernel const *kernel = &kernels[i];
+
+    /* one untimed pass over every input computes the checksum */
+
+    inputs = ninputs(kernel->unit);
+
+    mad_synth_init(&synth);
+    for (j = 0; j < 4; ++j)
+      mad_synth_init(&streams[j]);
+
+    verify   = 1;
+    checksum = 0;
+    kernel->run(inputs);
+    verify   = 0;
+
+    if (kernel->run == run_aliasreduce)
+      memcpy(scratch, spectra, sizeof(scratch));
+
+    elapsed = measure(kernel, period, &calls);
+
+    printf("%s\n    {\n", i ? "," : "");
+    printf("      \"name\": \"%s\",\n", kernel->name);
+    printf("      \"unit\": \"%s\",\n", kernel->unit);
+    printf("      \"inputs\": %lu,\n", inputs);
+    printf("      \"calls\": %lu,\n", calls);
+    printf("      \"ns_per_call\": %.1f,\n", elapsed * 1e9 / calls);
+    printf("      \"checksum\": \"%08lx\"\n", checksum);
+    printf("    }");
+  }
+
+  printf("\n  ]\n}\n");
+
+  free(data);
+
+  return 0;
+}
@@ -31,18 +31,24 @@
 #  define CHAR_BIT  8
 # endif
 
+# if defined(FPM_FLOAT)
+#  include <math.h>
+# endif
+
 # include "fixed.h"
 # include "bit.h"
 # include "stream.h"
 # include "frame.h"
 # include "layer12.h"
+# include "gain.h"
+# include "stats.h"
 
 /*
  * scalefactor table
  * used in both Layer I and Layer II decoding
  */
 static
-mad_fixed_t const sf_table[64] = {
+mad_fixed_t TABLE_CONST sf_table[64] = {
 # include "sf_table.dat"
 };
 
@@ -50,7 +56,7 @@ mad_fixed_t const sf_table[64] = {
 
 /* linear scaling table */
 static
-mad_fixed_t const linear_table[14] = {
+mad_fixed_t TABLE_CONST linear_table[14] = {
   MAD_F(0x15555555),  /* 2^2  / (2^2  - 1) == 1.33333333333333 */
   MAD_F(0x12492492),  /* 2^3  / (2^3  - 1) == 1.14285714285714 */
   MAD_F(0x11111111),  /* 2^4  / (2^4  - 1) == 1.06666666666667 */
@@ -67,37 +73,46 @@ mad_fixed_t const linear_table[14] = {
   MAD_F(0x10002000)   /* 2^15 / (2^15 - 1) == 1.00003051850948 */
 };
 
+/* reciprocals of the scalefactors that can carry a gained sample too far */
+static
+mad_fixed_t TABLE_CONST sf_reciprocal[3] = {
+  MAD_F(0x08000000),  /* 1 / sf_table[0] == 0.50000000000000 */
+  MAD_F(0x0a14517c),  /* 1 / sf_table[1] == 0.62996052494744 */
+  MAD_F(0x0cb2ff52)   /* 1 / sf_table[2] == 0.79370052598410 */
+};
+
 /*
  * NAME:	I_sample()
  * DESCRIPTION:	decode one requantized Layer I sample from a bitstream
  */
 static
-mad_fixed_t I_sample(struct mad_bitptr *ptr, unsigned int nb, struct mad_stream *stream)
+mad_fixed_t I_sample(struct mad_bitptr *ptr, unsigned int nb)
 {
+  signed int value;
   mad_fixed_t sample;
-  struct mad_bitptr frameend_ptr;
-
-  mad_bit_init(&frameend_ptr, stream->next_frame);
 
-  if (mad_bit_length(ptr, &frameend_ptr) < nb) {
-    stream->error = MAD_ERROR_LOSTSYNC;
-    stream->sync = 0;
-    return 0;
-  }
-  sample = mad_bit_read(ptr, nb);
+  value = mad_bit_read(ptr, nb);
 
   /* invert most significant bit, extend sign, then scale to fixed format */
 
-  sample ^= 1 << (nb - 1);
-  sample |= -(sample & (1 << (nb - 1)));
+  value ^= 1 << (nb - 1);
+  value |= -(value & (1 << (nb - 1)));
 
-  sample <<= MAD_F_FRACBITS - (nb - 1);
+# if defined(FPM_FLOAT)
+  sample = (mad_fixed_t) value / (1 << (nb - 1));
+# else
+  sample = value << (MAD_F_FRACBITS - (nb - 1));
+# endif
 
   /* requantize the sample */
 
   /* s'' = (2^nb / (2^nb - 1)) * (s''' + 2^(-nb + 1)) */
 
+# if defined(FPM_FLOAT)
+  sample += MAD_F_ONE / (1 << (nb - 1));
+# else
   sample += MAD_F_ONE >> (nb - 1);
+# endif
 
   return mad_f_mul(sample, linear_table[nb - 2]);
 
@@ -112,9 +127,14 @@ mad_fixed_t I_sample(struct mad_bitptr *ptr, unsigned int nb, struct mad_stream
 int mad_layer_I(struct mad_stream *stream, struct mad_frame *frame)
 {
   struct mad_header *header = &frame->header;
-  unsigned int nch, bound, ch, s, sb, nb;
+  unsigned int nch, bound, ch, s, sb, nb, nsf, nbits;
   unsigned char allocation[2][32], scalefactor[2][32];
+  mad_fixed_t factor[2][32], limit[2][32];
+  struct mad_gain_block const *gain;
   struct mad_bitptr bufend_ptr, frameend_ptr;
+  STATS_LAP_DECL(lap)
+
+  STATS_LAP_START(lap, stream->stats);
 
   mad_bit_init(&bufend_ptr, stream->bufend);
   mad_bit_init(&frameend_ptr, stream->next_frame);
@@ -146,15 +166,25 @@ int mad_layer_I(struct mad_stream *stream, struct mad_frame *frame)
     }
   }
 
+  STATS_LAP(lap, MAD_STAGE_CRC);
+
+  /*
+   * The frame length is checked up front for each part of the frame: the
+   * bit allocations, then the scalefactors and samples they imply. Short
+   * frames are rejected before decoding that part, so none of the reads
+   * below need their own bounds check.
+   */
+
+  if (mad_bit_length(&stream->ptr, &frameend_ptr) <
+      4 * (bound * nch + (32 - bound)))
+    goto lostsync;
+
   /* decode bit allocations */
 
+  nsf = nbits = 0;
+
   for (sb = 0; sb < bound; ++sb) {
     for (ch = 0; ch < nch; ++ch) {
-      if (mad_bit_length(&stream->ptr, &frameend_ptr) < 4) {
-	stream->error = MAD_ERROR_LOSTSYNC;
-	stream->sync = 0;
-	return -1;
-      }
       nb = mad_bit_read(&stream->ptr, 4);
 
       if (nb == 15) {
@@ -163,15 +193,15 @@ int mad_layer_I(struct mad_stream *stream, struct mad_frame *frame)
       }
 
       allocation[ch][sb] = nb ? nb + 1 : 0;
+
+      if (nb) {
+	++nsf;
+	nbits += nb + 1;
+      }
     }
   }
 
   for (sb = bound; sb < 32; ++sb) {
-    if (mad_bit_length(&stream->ptr, &frameend_ptr) < 4) {
-      stream->error = MAD_ERROR_LOSTSYNC;
-      stream->sync = 0;
-      return -1;
-    }
     nb = mad_bit_read(&stream->ptr, 4);
 
     if (nb == 15) {
@@ -181,18 +211,23 @@ int mad_layer_I(struct mad_stream *stream, struct mad_frame *frame)
 
     allocation[0][sb] =
     allocation[1][sb] = nb ? nb + 1 : 0;
+
+    if (nb) {
+      nsf += nch;
+      nbits += nb + 1;
+    }
   }
 
+  STATS_LAP(lap, MAD_STAGE_SIDEINFO);
+
   /* decode scalefactors */
 
+  if (mad_bit_length(&stream->ptr, &frameend_ptr) < 6 * nsf)
+    goto lostsync;
+
   for (sb = 0; sb < 32; ++sb) {
     for (ch = 0; ch < nch; ++ch) {
       if (allocation[ch][sb]) {
-        if (mad_bit_length(&stream->ptr, &frameend_ptr) < 6) {
-	  stream->error = MAD_ERROR_LOSTSYNC;
-	  stream->sync = 0;
-	  return -1;
-	}
 	scalefactor[ch][sb] = mad_bit_read(&stream->ptr, 6);
 
 # if defined(OPT_STRICT)
@@ -210,17 +245,58 @@ int mad_layer_I(struct mad_stream *stream, struct mad_frame *frame)
     }
   }
 
+  /*
+   * Fold any subband gains into the scalefactors. Requantized samples lie
+   * within [-4/3, 4/3], and every gain limit is at least MAD_GAIN_CEIL / 4,
+   * so only the three largest scalefactors can carry a gained sample out of
+   * range. Their limit is the gain's divided by the scalefactor, less a
+   * margin for the rounding of mad_f_mul().
+   */
+
+  gain = frame->gain ? mad_gain_step(frame->gain, 12) : 0;
+
+  for (ch = 0; ch < nch; ++ch) {
+    for (sb = 0; sb < 32; ++sb) {
+      unsigned int index = scalefactor[ch][sb];
+
+      factor[ch][sb] = allocation[ch][sb] ? sf_table[index] : 0;
+      limit[ch][sb]  = MAD_F_MAX;
+
+      if (gain) {
+	factor[ch][sb] = mad_gain_mul(factor[ch][sb], gain->gain[ch][sb],
+				      gain->limit[ch][sb]);
+
+	if (index < 3) {
+	  limit[ch][sb]  = mad_f_mul(gain->limit[ch][sb],
+				     sf_reciprocal[index]);
+	  limit[ch][sb] -= limit[ch][sb] / 4096;
+	}
+      }
+    }
+  }
+
+  STATS_LAP(lap, MAD_STAGE_SCALEFACTORS);
+
   /* decode samples */
 
+  if (mad_bit_length(&stream->ptr, &frameend_ptr) < 12 * nbits)
+    goto lostsync;
+
   for (s = 0; s < 12; ++s) {
     for (sb = 0; sb < bound; ++sb) {
       for (ch = 0; ch < nch; ++ch) {
 	nb = allocation[ch][sb];
-	frame->sbsample[ch][s][sb] = nb ?
-	  mad_f_mul(I_sample(&stream->ptr, nb, stream),
-		    sf_table[scalefactor[ch][sb]]) : 0;
-	if (stream->error != 0)
-	  return -1;
+	if (nb) {
+	  mad_fixed_t sample;
+
+	  sample = I_sample(&stream->ptr, nb);
+
+	  frame->sbsample[ch][s][sb] = gain ?
+	    mad_gain_mul(sample, factor[ch][sb], limit[ch][sb]) :
+	    mad_f_mul(sample, factor[ch][sb]);
+	}
+	else
+	  frame->sbsample[ch][s][sb] = 0;
       }
     }
 
@@ -229,18 +305,12 @@ int mad_layer_I(struct mad_stream *stream, struct mad_frame *frame)
       if (nb) {
 	mad_fixed_t sample;
 
-	if (mad_bit_length(&stream->ptr, &frameend_ptr) < nb) {
-	  stream->error = MAD_ERROR_LOSTSYNC;
-	  stream->sync = 0;
-          return -1;
-	}
-	sample = I_sample(&stream->ptr, nb, stream);
-        if (stream->error != 0)
-	  return -1;
+	sample = I_sample(&stream->ptr, nb);
 
 	for (ch = 0; ch < nch; ++ch) {
-	  frame->sbsample[ch][s][sb] =
-	    mad_f_mul(sample, sf_table[scalefactor[ch][sb]]);
+	  frame->sbsample[ch][s][sb] = gain ?
+	    mad_gain_mul(sample, factor[ch][sb], limit[ch][sb]) :
+	    mad_f_mul(sample, factor[ch][sb]);
 	}
       }
       else {
@@ -250,7 +320,15 @@ int mad_layer_I(struct mad_stream *stream, struct mad_frame *frame)
     }
   }
 
+  STATS_LAP(lap, MAD_STAGE_REQUANTIZE);
+
   return 0;
+
+ lostsync:
+  stream->error = MAD_ERROR_LOSTSYNC;
+  stream->sync = 0;
+
+  return -1;
 }
 
 /* --- Layer II ------------------------------------------------------------ */
@@ -311,10 +389,62 @@ struct quantclass {
   unsigned char bits;
   mad_fixed_t C;
   mad_fixed_t D;
-} const qc_table[17] = {
+} TABLE_CONST qc_table[17] = {
 # include "qc_table.dat"
 };
 
+/*
+ * degrouping tables
+ *
+ * For the grouped quantization classes (3, 5, and 9 levels) each codeword
+ * holds three samples as base nlevels digits. These tables give the three
+ * digits of every possible codeword, four bits each, least significant
+ * first. As with the remainders they replace, every digit is reduced
+ * modulo nlevels, invalid codewords included.
+ */
+# define DEGROUP(n, c)  \
+    ((c) % (n) | (c) / (n) % (n) << 4 | (c) / ((n) * (n)) % (n) << 8)
+
+# define DEGROUP4(n, c)  \
+    DEGROUP(n, (c) + 0), DEGROUP(n, (c) + 1),  \
+    DEGROUP(n, (c) + 2), DEGROUP(n, (c) + 3)
+# define DEGROUP16(n, c)  \
+    DEGROUP4(n, (c) +  0), DEGROUP4(n, (c) +  4),  \
+    DEGROUP4(n, (c) +  8), DEGROUP4(n, (c) + 12)
+# define DEGROUP64(n, c)  \
+    DEGROUP16(n, (c) +  0), DEGROUP16(n, (c) + 16),  \
+    DEGROUP16(n, (c) + 32), DEGROUP16(n, (c) + 48)
+# define DEGROUP256(n, c)  \
+    DEGROUP64(n, (c) +   0), DEGROUP64(n, (c) +  64),  \
+    DEGROUP64(n, (c) + 128), DEGROUP64(n, (c) + 192)
+
+static
+unsigned short const degroup_3[32] = {
+  DEGROUP16(3, 0), DEGROUP16(3, 16)
+};
+
+static
+unsigned short const degroup_5[128] = {
+  DEGROUP64(5, 0), DEGROUP64(5, 64)
+};
+
+static
+unsigned short const degroup_9[1024] = {
+  DEGROUP256(9, 0), DEGROUP256(9, 256), DEGROUP256(9, 512), DEGROUP256(9, 768)
+};
+
+# undef DEGROUP256
+# undef DEGROUP64
+# undef DEGROUP16
+# undef DEGROUP4
+# undef DEGROUP
+
+/* degrouping tables indexed by quantclass->group */
+static
+unsigned short const *const degroup_table[5] = {
+  0, 0, degroup_3, degroup_5, degroup_9
+};
+
 /*
  * NAME:	II_samples()
  * DESCRIPTION:	decode three requantized Layer II samples from a bitstream
@@ -322,53 +452,42 @@ struct quantclass {
 static
 void II_samples(struct mad_bitptr *ptr,
 		struct quantclass const *quantclass,
-		mad_fixed_t output[3], struct mad_stream *stream)
+		mad_fixed_t output[3])
 {
   unsigned int nb, s, sample[3];
-  struct mad_bitptr frameend_ptr;
-
-  mad_bit_init(&frameend_ptr, stream->next_frame);
 
   nb = quantclass->group;
   if (nb) {
-    unsigned int c, nlevels;
+    unsigned int c;
 
-    if (mad_bit_length(ptr, &frameend_ptr) < quantclass->bits) {
-      stream->error = MAD_ERROR_LOSTSYNC;
-      stream->sync = 0;
-      return;
-    }
     /* degrouping */
-    c = mad_bit_read(ptr, quantclass->bits);
-    nlevels = quantclass->nlevels;
+    c = degroup_table[nb][mad_bit_read(ptr, quantclass->bits)];
 
-    for (s = 0; s < 3; ++s) {
-      sample[s] = c % nlevels;
-      c /= nlevels;
-    }
+    sample[0] = (c >> 0) & 0xf;
+    sample[1] = (c >> 4) & 0xf;
+    sample[2] = (c >> 8);
   }
   else {
     nb = quantclass->bits;
 
-    for (s = 0; s < 3; ++s) {
-      if (mad_bit_length(ptr, &frameend_ptr) < nb) {
-	stream->error = MAD_ERROR_LOSTSYNC;
-	stream->sync = 0;
-	return;
-      }
+    for (s = 0; s < 3; ++s)
       sample[s] = mad_bit_read(ptr, nb);
-    }
   }
 
   for (s = 0; s < 3; ++s) {
+    signed int value;
     mad_fixed_t requantized;
 
     /* invert most significant bit, extend sign, then scale to fixed format */
 
-    requantized  = sample[s] ^ (1 << (nb - 1));
-    requantized |= -(requantized & (1 << (nb - 1)));
+    value  = sample[s] ^ (1 << (nb - 1));
+    value |= -(value & (1 << (nb - 1)));
 
-    requantized <<= MAD_F_FRACBITS - (nb - 1);
+# if defined(FPM_FLOAT)
+    requantized = (mad_fixed_t) value / (1 << (nb - 1));
+# else
+    requantized = value << (MAD_F_FRACBITS - (nb - 1));
+# endif
 
     /* requantize the sample */
 
@@ -390,10 +509,15 @@ int mad_layer_II(struct mad_stream *stream, struct mad_frame *frame)
   struct mad_header *header = &frame->header;
   struct mad_bitptr start;
   unsigned int index, sblimit, nbal, nch, bound, gr, ch, s, sb;
+  unsigned int nsel, nsf, nbits;
   unsigned char const *offsets;
   unsigned char allocation[2][32], scfsi[2][32], scalefactor[2][32][3];
-  mad_fixed_t samples[3];
+  mad_fixed_t samples[3], factor[2][32];
+  struct mad_gain_block const *gain;
   struct mad_bitptr frameend_ptr;
+  STATS_LAP_DECL(lap)
+
+  STATS_LAP_START(lap, stream->stats);
 
   mad_bit_init(&frameend_ptr, stream->next_frame);
 
@@ -457,48 +581,76 @@ int mad_layer_II(struct mad_stream *stream, struct mad_frame *frame)
 
   start = stream->ptr;
 
+  /*
+   * As in Layer I, the frame length is checked up front for each part of
+   * the frame: the bit allocations, the scalefactor selection info, then
+   * the scalefactors and samples they imply.
+   */
+
+  nbits = 0;
+
+  for (sb = 0; sb < sblimit; ++sb)
+    nbits += bitalloc_table[offsets[sb]].nbal * (sb < bound ? nch : 1);
+
+  if (mad_bit_length(&stream->ptr, &frameend_ptr) < nbits)
+    goto lostsync;
+
   /* decode bit allocations */
 
+  nsel = nbits = 0;
+
   for (sb = 0; sb < bound; ++sb) {
     nbal = bitalloc_table[offsets[sb]].nbal;
 
     for (ch = 0; ch < nch; ++ch) {
-      if (mad_bit_length(&stream->ptr, &frameend_ptr) < nbal) {
-	stream->error = MAD_ERROR_LOSTSYNC;
-	stream->sync = 0;
-	return -1;
+      index = allocation[ch][sb] = mad_bit_read(&stream->ptr, nbal);
+
+      if (index) {
+	index = offset_table[bitalloc_table[offsets[sb]].offset][index - 1];
+
+	++nsel;
+	nbits += qc_table[index].group ?
+	  qc_table[index].bits : 3 * qc_table[index].bits;
       }
-      allocation[ch][sb] = mad_bit_read(&stream->ptr, nbal);
     }
   }
 
   for (sb = bound; sb < sblimit; ++sb) {
     nbal = bitalloc_table[offsets[sb]].nbal;
 
-    if (mad_bit_length(&stream->ptr, &frameend_ptr) < nbal) {
-      stream->error = MAD_ERROR_LOSTSYNC;
-      stream->sync = 0;
-      return -1;
-    }
+    index =
     allocation[0][sb] =
     allocation[1][sb] = mad_bit_read(&stream->ptr, nbal);
+
+    if (index) {
+      index = offset_table[bitalloc_table[offsets[sb]].offset][index - 1];
+
+      nsel += nch;
+      nbits += qc_table[index].group ?
+	qc_table[index].bits : 3 * qc_table[index].bits;
+    }
   }
 
   /* decode scalefactor selection info */
 
+  if (mad_bit_length(&stream->ptr, &frameend_ptr) < 2 * nsel)
+    goto lostsync;
+
+  nsf = 0;
+
   for (sb = 0; sb < sblimit; ++sb) {
     for (ch = 0; ch < nch; ++ch) {
       if (allocation[ch][sb]) {
-	if (mad_bit_length(&stream->ptr, &frameend_ptr) < 2) {
-	  stream->error = MAD_ERROR_LOSTSYNC;
-	  stream->sync = 0;
-	  return -1;
-	}
 	scfsi[ch][sb] = mad_bit_read(&stream->ptr, 2);
+
+	/* scfsi 0 carries three scalefactors, 1 and 3 two, and 2 one */
+	nsf += (scfsi[ch][sb] == 0) ? 3 : (scfsi[ch][sb] == 2) ? 1 : 2;
       }
     }
   }
 
+  STATS_LAP(lap, MAD_STAGE_SIDEINFO);
+
   /* check CRC word */
 
   if (header->flags & MAD_FLAG_PROTECTION) {
@@ -513,16 +665,16 @@ int mad_layer_II(struct mad_stream *stream, struct mad_frame *frame)
     }
   }
 
+  STATS_LAP(lap, MAD_STAGE_CRC);
+
   /* decode scalefactors */
 
+  if (mad_bit_length(&stream->ptr, &frameend_ptr) < 6 * nsf)
+    goto lostsync;
+
   for (sb = 0; sb < sblimit; ++sb) {
     for (ch = 0; ch < nch; ++ch) {
       if (allocation[ch][sb]) {
-	if (mad_bit_length(&stream->ptr, &frameend_ptr) < 6) {
-	  stream->error = MAD_ERROR_LOSTSYNC;
-	  stream->sync = 0;
-	  return -1;
-	}
 	scalefactor[ch][sb][0] = mad_bit_read(&stream->ptr, 6);
 
 	switch (scfsi[ch][sb]) {
@@ -533,21 +685,11 @@ int mad_layer_II(struct mad_stream *stream, struct mad_frame *frame)
 	  break;
 
 	case 0:
-	  if (mad_bit_length(&stream->ptr, &frameend_ptr) < 6) {
-	    stream->error = MAD_ERROR_LOSTSYNC;
-	    stream->sync = 0;
-	    return -1;
-	  }
 	  scalefactor[ch][sb][1] = mad_bit_read(&stream->ptr, 6);
 	  /* fall through */
 
 	case 1:
 	case 3:
-	  if (mad_bit_length(&stream->ptr, &frameend_ptr) < 6) {
-	    stream->error = MAD_ERROR_LOSTSYNC;
-	    stream->sync = 0;
-	    return -1;
-	  }
 	  scalefactor[ch][sb][2] = mad_bit_read(&stream->ptr, 6);
 	}
 
@@ -571,23 +713,46 @@ int mad_layer_II(struct mad_stream *stream, struct mad_frame *frame)
     }
   }
 
+  STATS_LAP(lap, MAD_STAGE_SCALEFACTORS);
+
   /* decode samples */
 
+  if (mad_bit_length(&stream->ptr, &frameend_ptr) < 12 * nbits)
+    goto lostsync;
+
   for (gr = 0; gr < 12; ++gr) {
+    if (gr % 4 == 0) {
+      /*
+       * Fold any subband gains into the scalefactors. Requantized samples
+       * exceed [-1, 1] by at most 2^-16, so once the folded factor is
+       * saturated at MAD_GAIN_CEIL the products need no check of their own.
+       */
+
+      gain = frame->gain ? mad_gain_step(frame->gain, 12) : 0;
+
+      for (ch = 0; ch < nch; ++ch) {
+	for (sb = 0; sb < sblimit; ++sb) {
+	  factor[ch][sb] = allocation[ch][sb] ?
+	    sf_table[scalefactor[ch][sb][gr / 4]] : 0;
+
+	  if (gain) {
+	    factor[ch][sb] = mad_gain_mul(factor[ch][sb], gain->gain[ch][sb],
+					  gain->limit[ch][sb]);
+	  }
+	}
+      }
+    }
+
     for (sb = 0; sb < bound; ++sb) {
       for (ch = 0; ch < nch; ++ch) {
         index = allocation[ch][sb];
         if (index) {
           index = offset_table[bitalloc_table[offsets[sb]].offset][index - 1];
 
-	  II_samples(&stream->ptr, &qc_table[index], samples, stream);
-	  if (stream->error != 0)
-            return -1;
+	  II_samples(&stream->ptr, &qc_table[index], samples);
 
-	  for (s = 0; s < 3; ++s) {
-	    frame->sbsample[ch][3 * gr + s][sb] =
-	      mad_f_mul(samples[s], sf_table[scalefactor[ch][sb][gr / 4]]);
-	  }
+	  for (s = 0; s < 3; ++s)
+	    frame->sbsample[ch][3 * gr + s][sb] = samples[s];
 	}
 	else {
 	  for (s = 0; s < 3; ++s)
@@ -601,15 +766,11 @@ int mad_layer_II(struct mad_stream *stream, struct mad_frame *frame)
       if (index) {
 	index = offset_table[bitalloc_table[offsets[sb]].offset][index - 1];
 
-	II_samples(&stream->ptr, &qc_table[index], samples, stream);
-	if (stream->error != 0)
-          return -1;
+	II_samples(&stream->ptr, &qc_table[index], samples);
 
 	for (ch = 0; ch < nch; ++ch) {
-	  for (s = 0; s < 3; ++s) {
-	    frame->sbsample[ch][3 * gr + s][sb] =
-	      mad_f_mul(samples[s], sf_table[scalefactor[ch][sb][gr / 4]]);
-	  }
+	  for (s = 0; s < 3; ++s)
+	    frame->sbsample[ch][3 * gr + s][sb] = samples[s];
 	}
       }
       else {
@@ -620,13 +781,60 @@ int mad_layer_II(struct mad_stream *stream, struct mad_frame *frame)
       }
     }
 
+    /* s' = factor * s'' for the whole granule */
+
     for (ch = 0; ch < nch; ++ch) {
       for (s = 0; s < 3; ++s) {
+	mad_fixed_t *sample = frame->sbsample[ch][3 * gr + s];
+
+	for (sb = 0; sb < sblimit; ++sb)
+	  sample[sb] = mad_f_mul(sample[sb], factor[ch][sb]);
+
 	for (sb = sblimit; sb < 32; ++sb)
-	  frame->sbsample[ch][3 * gr + s][sb] = 0;
+	  sample[sb] = 0;
       }
     }
   }
 
+  STATS_LAP(lap, MAD_STAGE_REQUANTIZE);
+
   return 0;
+
+ lostsync:
+  stream->error = MAD_ERROR_LOSTSYNC;
+  stream->sync = 0;
+
+  return -1;
+}
+
+# if defined(FPM_FLOAT)
+/*
+ * NAME:	layer12->init_tables()
+ * DESCRIPTION:	compute the Layer I and II tables in double precision
+ */
+void mad_layer12_init_tables(void)
+{
+  static int done;
+  unsigned int i, nb;
+
+  if (done)
+    return;
+
+  /* sf_table[63] is the compatibility entry and stays zero */
+
+  for (i = 0; i < 63; ++i)
+    sf_table[i] = pow(2, 1 - i / 3.0);
+
+  for (nb = 2; nb <= 15; ++nb)
+    linear_table[nb - 2] = (double) (1L << nb) / ((1L << nb) - 1);
+
+  /* C = 2^nb / nlevels; the D values are exact powers of two */
+
+  for (i = 0; i < sizeof(qc_table) / sizeof(qc_table[0]); ++i) {
+    nb = qc_table[i].group ? qc_table[i].group : qc_table[i].bits;
+    qc_table[i].C = (double) (1L << nb) / qc_table[i].nlevels;
+  }
+
+  done = 1;
 }
+# endif
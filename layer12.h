@@ -28,4 +28,8 @@
 int mad_layer_I(struct mad_stream *, struct mad_frame *);
 int mad_layer_II(struct mad_stream *, struct mad_frame *);
 
+# if defined(FPM_FLOAT)
+void mad_layer12_init_tables(void);
+# endif
+
 # endif
@@ -38,12 +38,20 @@
 #  define CHAR_BIT  8
 # endif
 
+# if defined(FPM_FLOAT)
+#  include <math.h>
+# endif
+
 # include "fixed.h"
 # include "bit.h"
 # include "stream.h"
 # include "frame.h"
 # include "huffman.h"
 # include "layer3.h"
+# include "gain.h"
+# include "pool.h"
+# include "alloc.h"
+# include "stats.h"
 
 /* --- Layer III ----------------------------------------------------------- */
 
@@ -82,6 +90,9 @@ struct sideinfo {
 
       /* from main_data */
       unsigned char scalefac[39];	/* scalefac_l and/or scalefac_s */
+
+      /* from Huffman decoding */
+      unsigned short rzero;		/* start of the all-zero region */
     } ch[2];
   } gr[2];
 };
@@ -328,14 +339,30 @@ unsigned char const pretab[22] = {
  * table for requantization
  *
  * rq_table[x].mantissa * 2^(rq_table[x].exponent) = x^(4/3)
+ *
+ * OPT_COMPACT_RQ keeps only the first 257 entries (1 KB instead of 32 KB)
+ * and computes the rest in III_power().
+ *
+ * With FPM_FLOAT, rq_table[x] = x^(4/3) is computed at run time instead.
  */
+# if defined(OPT_COMPACT_RQ) && !defined(FPM_FLOAT)
+#  define RQ_TABLE_SIZE  257
+# else
+#  define RQ_TABLE_SIZE  8207
+# endif
+
+# if defined(FPM_FLOAT)
+static
+mad_fixed_t rq_table[RQ_TABLE_SIZE];
+# else
 static
 struct fixedfloat {
   unsigned long mantissa  : 27;
   unsigned short exponent :  5;
-} const rq_table[8207] = {
+} const rq_table[RQ_TABLE_SIZE] = {
 # include "rq_table.dat"
 };
+# endif
 
 /*
  * fractional powers of two
@@ -344,7 +371,7 @@ struct fixedfloat {
  * root_table[3 + x] = 2^(x/4)
  */
 static
-mad_fixed_t const root_table[7] = {
+mad_fixed_t TABLE_CONST root_table[7] = {
   MAD_F(0x09837f05) /* 2^(-3/4) == 0.59460355750136 */,
   MAD_F(0x0b504f33) /* 2^(-2/4) == 0.70710678118655 */,
   MAD_F(0x0d744fcd) /* 2^(-1/4) == 0.84089641525371 */,
@@ -363,7 +390,7 @@ mad_fixed_t const root_table[7] = {
  * ca[i] = c[i] / sqrt(1 + c[i]^2)
  */
 static
-mad_fixed_t const cs[8] = {
+mad_fixed_t TABLE_CONST cs[8] = {
   +MAD_F(0x0db84a81) /* +0.857492926 */, +MAD_F(0x0e1b9d7f) /* +0.881741997 */,
   +MAD_F(0x0f31adcf) /* +0.949628649 */, +MAD_F(0x0fbba815) /* +0.983314592 */,
   +MAD_F(0x0feda417) /* +0.995517816 */, +MAD_F(0x0ffc8fc8) /* +0.999160558 */,
@@ -371,7 +398,7 @@ mad_fixed_t const cs[8] = {
 };
 
 static
-mad_fixed_t const ca[8] = {
+mad_fixed_t TABLE_CONST ca[8] = {
   -MAD_F(0x083b5fe7) /* -0.514495755 */, -MAD_F(0x078c36d2) /* -0.471731969 */,
   -MAD_F(0x05039814) /* -0.313377454 */, -MAD_F(0x02e91dd1) /* -0.181913200 */,
   -MAD_F(0x0183603a) /* -0.094574193 */, -MAD_F(0x00a7cb87) /* -0.040965583 */,
@@ -386,7 +413,7 @@ mad_fixed_t const ca[8] = {
  * imdct_s[i /odd][k] = cos((PI / 24) * (2 * (6 + (i-1)/2) + 7) * (2 * k + 1))
  */
 static
-mad_fixed_t const imdct_s[6][6] = {
+mad_fixed_t TABLE_CONST imdct_s[6][6] = {
 # include "imdct_s.dat"
 };
 
@@ -398,7 +425,7 @@ mad_fixed_t const imdct_s[6][6] = {
  * window_l[i] = sin((PI / 36) * (i + 1/2))
  */
 static
-mad_fixed_t const window_l[36] = {
+mad_fixed_t TABLE_CONST window_l[36] = {
   MAD_F(0x00b2aa3e) /* 0.043619387 */, MAD_F(0x0216a2a2) /* 0.130526192 */,
   MAD_F(0x03768962) /* 0.216439614 */, MAD_F(0x04cfb0e2) /* 0.300705800 */,
   MAD_F(0x061f78aa) /* 0.382683432 */, MAD_F(0x07635284) /* 0.461748613 */,
@@ -429,7 +456,7 @@ mad_fixed_t const window_l[36] = {
  * window_s[i] = sin((PI / 12) * (i + 1/2))
  */
 static
-mad_fixed_t const window_s[12] = {
+mad_fixed_t TABLE_CONST window_s[12] = {
   MAD_F(0x0216a2a2) /* 0.130526192 */, MAD_F(0x061f78aa) /* 0.382683432 */,
   MAD_F(0x09bd7ca0) /* 0.608761429 */, MAD_F(0x0cb19346) /* 0.793353340 */,
   MAD_F(0x0ec835e8) /* 0.923879533 */, MAD_F(0x0fdcf549) /* 0.991444861 */,
@@ -446,7 +473,7 @@ mad_fixed_t const window_s[12] = {
  * is_table[i] = is_ratio[i] / (1 + is_ratio[i])
  */
 static
-mad_fixed_t const is_table[7] = {
+mad_fixed_t TABLE_CONST is_table[7] = {
   MAD_F(0x00000000) /* 0.000000000 */,
   MAD_F(0x0361962f) /* 0.211324865 */,
   MAD_F(0x05db3d74) /* 0.366025404 */,
@@ -464,7 +491,7 @@ mad_fixed_t const is_table[7] = {
  * is_lsf_table[1][i] = (1 /      sqrt(2)) ^(i + 1)
  */
 static
-mad_fixed_t const is_lsf_table[2][15] = {
+mad_fixed_t TABLE_CONST is_lsf_table[2][15] = {
   {
     MAD_F(0x0d744fcd) /* 0.840896415 */,
     MAD_F(0x0b504f33) /* 0.707106781 */,
@@ -910,23 +937,128 @@ void III_exponents(struct channel const *channel,
   }
 }
 
+# if defined(OPT_COMPACT_RQ) && !defined(FPM_FLOAT)
+/*
+ * NAME:	III_mulhi()
+ * DESCRIPTION:	return the high 32 bits of a 32x32-bit product (operands
+ *		must be less than 2^31)
+ */
+static
+unsigned long III_mulhi(unsigned long a, unsigned long b)
+{
+  unsigned long ah, al, bh, bl;
+
+  ah = a >> 16;
+  al = a & 0xffff;
+  bh = b >> 16;
+  bl = b & 0xffff;
+
+  return ah * bh + ((ah * bl + al * bh + ((al * bl) >> 16)) >> 16);
+}
+
+/*
+ * NAME:	III_power()
+ * DESCRIPTION:	compute x^(4/3) for x beyond the compact rq_table
+ */
+static
+void III_power(unsigned int value,
+	       unsigned long *mantissa, signed int *exponent)
+{
+  unsigned int shift, q, r;
+  unsigned long u, u2, u3, u4, f, m;
+
+  /*
+   * value = 2^shift * q * (1 + u), with shift a multiple of 3 so that
+   * (2^shift)^(4/3) is an exact power of two and q within the table.
+   * Since q >= 32, u < 1/32 and the binomial series for (1 + u)^(4/3)
+   * to the fourth order is good to better than 2^-29.
+   *
+   * Compared against the full table for every value from 257 to 8206,
+   * the mantissa differs by at most one LSB (1916 of 7950 entries).
+   */
+
+  shift = 3;
+  while ((q = value >> shift) >= RQ_TABLE_SIZE)
+    shift += 3;
+
+  r = value - (q << shift);
+
+  m = rq_table[q].mantissa;
+  *exponent = rq_table[q].exponent + shift / 3 * 4;
+
+  /* u and the powers of u in 0.32 fixed-point */
+
+  u  = ((unsigned long) r << (32 - shift)) / q;
+  u2 = III_mulhi(u,  u);
+  u3 = III_mulhi(u2, u);
+  u4 = III_mulhi(u3, u);
+
+  f = u + u / 3 + 2 * u2 / 9 - 4 * u3 / 81 + 5 * u4 / 243;
+
+  m += (III_mulhi(m << 4, f) + 8) >> 4;
+
+  if (m >= 1UL << 27) {
+    m = (m + 1) >> 1;
+    ++*exponent;
+  }
+
+  *mantissa = m;
+}
+# endif
+
 /*
  * NAME:	III_requantize()
  * DESCRIPTION:	requantize one (positive) value
+ *		(exp and frac are the quotient and remainder of the
+ *		scalefactor band exponent divided by 4)
  */
 static
-mad_fixed_t III_requantize(unsigned int value, signed int exp)
+mad_fixed_t III_requantize(unsigned int value, signed int exp, signed int frac)
 {
   mad_fixed_t requantized;
-  signed int frac;
-  struct fixedfloat const *power;
+# if defined(FPM_FLOAT)
+  double lsb;
+
+  requantized = ldexp(rq_table[value], exp);
+
+  /*
+   * The intensity stereo bound depends on which lines of the right channel
+   * are nonzero. A line that the fixed-point versions requantize to zero
+   * (rounding to 28 bits, then truncating the product with the fractional
+   * power of two) is therefore zero here too, so that the bound is the
+   * same as theirs.
+   */
 
-  frac = exp % 4;  /* assumes sign(frac) == sign(exp) */
-  exp /= 4;
+  lsb = floor(requantized * (1L << MAD_F_FRACBITS) + 0.5);
+  if (lsb == 0 || (frac && floor(lsb * root_table[3 + frac]) == 0))
+    requantized = 0;
 
-  power = &rq_table[value];
-  requantized = power->mantissa;
-  exp += power->exponent;
+  /* overflow is clipped as in the fixed-point versions */
+
+  if (requantized > MAD_F_MAX)
+    requantized = MAD_F_MAX;
+
+  return frac ? mad_f_mul(requantized, root_table[3 + frac]) : requantized;
+# else
+#  if defined(OPT_COMPACT_RQ)
+  if (value >= RQ_TABLE_SIZE) {
+    unsigned long mantissa;
+    signed int exponent;
+
+    III_power(value, &mantissa, &exponent);
+
+    requantized = mantissa;
+    exp += exponent;
+  }
+  else
+#  endif
+  {
+    struct fixedfloat const *power;
+
+    power = &rq_table[value];
+    requantized = power->mantissa;
+    exp += power->exponent;
+  }
 
   if (exp < 0) {
     if (-exp >= sizeof(mad_fixed_t) * CHAR_BIT) {
@@ -941,10 +1073,10 @@ mad_fixed_t III_requantize(unsigned int value, signed int exp)
   else {
     if (exp >= 5) {
       /* overflow */
-# if defined(DEBUG)
+#  if defined(DEBUG)
       fprintf(stderr, "requantize overflow (%f * 2^%d)\n",
 	      mad_f_todouble(requantized), exp);
-# endif
+#  endif
       requantized = MAD_F_MAX;
     }
     else
@@ -952,6 +1084,7 @@ mad_fixed_t III_requantize(unsigned int value, signed int exp)
   }
 
   return frac ? mad_f_mul(requantized, root_table[3 + frac]) : requantized;
+# endif
 }
 
 /* we must take care that sz >= bits and sz < sizeof(long) lest bits == 0 */
@@ -970,7 +1103,7 @@ enum mad_error III_huffdecode(struct mad_bitptr *ptr, mad_fixed_t xr[576],
 			      unsigned char const *sfbwidth,
 			      signed int part3_length)
 {
-  signed int exponents[39], exp;
+  signed int exponents[39], exp, exp4, frac;
   signed int const *expptr;
   struct mad_bitptr peek;
   signed int bits_left, cachesz, fakebits;
@@ -1019,6 +1152,8 @@ enum mad_error III_huffdecode(struct mad_bitptr *ptr, mad_fixed_t xr[576],
 
     expptr  = &exponents[0];
     exp     = *expptr++;
+    exp4    = exp / 4;
+    frac    = exp % 4;  /* assumes sign(frac) == sign(exp) */
     reqhits = 0;
 
     big_values = channel->big_values;
@@ -1049,7 +1184,9 @@ enum mad_error III_huffdecode(struct mad_bitptr *ptr, mad_fixed_t xr[576],
 	}
 
 	if (exp != *expptr) {
-	  exp = *expptr;
+	  exp  = *expptr;
+	  exp4 = exp / 4;
+	  frac = exp % 4;
 	  reqhits = 0;
 	}
 
@@ -1115,7 +1252,7 @@ enum mad_error III_huffdecode(struct mad_bitptr *ptr, mad_fixed_t xr[576],
 	  value += MASK(bitcache, cachesz, linbits);
 	  cachesz -= linbits;
 
-	  requantized = III_requantize(value, exp);
+	  requantized = III_requantize(value, exp4, frac);
 	  goto x_final;
 
 	default:
@@ -1123,7 +1260,7 @@ enum mad_error III_huffdecode(struct mad_bitptr *ptr, mad_fixed_t xr[576],
 	    requantized = reqcache[value];
 	  else {
 	    reqhits |= (1 << value);
-	    requantized = reqcache[value] = III_requantize(value, exp);
+	    requantized = reqcache[value] = III_requantize(value, exp4, frac);
 	  }
 
 	x_final:
@@ -1157,7 +1294,7 @@ enum mad_error III_huffdecode(struct mad_bitptr *ptr, mad_fixed_t xr[576],
 	  value += MASK(bitcache, cachesz, linbits);
 	  cachesz -= linbits;
 
-	  requantized = III_requantize(value, exp);
+	  requantized = III_requantize(value, exp4, frac);
 	  goto y_final;
 
 	default:
@@ -1165,7 +1302,7 @@ enum mad_error III_huffdecode(struct mad_bitptr *ptr, mad_fixed_t xr[576],
 	    requantized = reqcache[value];
 	  else {
 	    reqhits |= (1 << value);
-	    requantized = reqcache[value] = III_requantize(value, exp);
+	    requantized = reqcache[value] = III_requantize(value, exp4, frac);
 	  }
 
 	y_final:
@@ -1187,7 +1324,7 @@ enum mad_error III_huffdecode(struct mad_bitptr *ptr, mad_fixed_t xr[576],
 	    requantized = reqcache[value];
 	  else {
 	    reqhits |= (1 << value);
-	    requantized = reqcache[value] = III_requantize(value, exp);
+	    requantized = reqcache[value] = III_requantize(value, exp4, frac);
 	  }
 
 	  if (cachesz - fakebits < 1)
@@ -1207,7 +1344,7 @@ enum mad_error III_huffdecode(struct mad_bitptr *ptr, mad_fixed_t xr[576],
 	    requantized = reqcache[value];
 	  else {
 	    reqhits |= (1 << value);
-	    requantized = reqcache[value] = III_requantize(value, exp);
+	    requantized = reqcache[value] = III_requantize(value, exp4, frac);
 	  }
 
 	  if (cachesz - fakebits < 1)
@@ -1228,7 +1365,7 @@ enum mad_error III_huffdecode(struct mad_bitptr *ptr, mad_fixed_t xr[576],
 
     table = mad_huff_quad_table[channel->flags & count1table_select];
 
-    requantized = III_requantize(1, exp);
+    requantized = III_requantize(1, exp4, frac);
 
     while (cachesz + bits_left - fakebits > 0 && xrptr <= &xr[572]) {
       union huffquad const *quad;
@@ -1271,8 +1408,10 @@ enum mad_error III_huffdecode(struct mad_bitptr *ptr, mad_fixed_t xr[576],
 	sfbound += *sfbwidth++;
 
 	if (exp != *expptr) {
-	  exp = *expptr;
-	  requantized = III_requantize(1, exp);
+	  exp  = *expptr;
+	  exp4 = exp / 4;
+	  frac = exp % 4;
+	  requantized = III_requantize(1, exp4, frac);
 	}
 
 	++expptr;
@@ -1294,8 +1433,10 @@ enum mad_error III_huffdecode(struct mad_bitptr *ptr, mad_fixed_t xr[576],
 	sfbound += *sfbwidth++;
 
 	if (exp != *expptr) {
-	  exp = *expptr;
-	  requantized = III_requantize(1, exp);
+	  exp  = *expptr;
+	  exp4 = exp / 4;
+	  frac = exp % 4;
+	  requantized = III_requantize(1, exp4, frac);
 	}
 
 	++expptr;
@@ -1323,6 +1464,8 @@ enum mad_error III_huffdecode(struct mad_bitptr *ptr, mad_fixed_t xr[576],
 # endif
 
   /* rzero */
+  channel->rzero = xrptr - xr;
+
   while (xrptr < &xr[576]) {
     xrptr[0] = 0;
     xrptr[1] = 0;
@@ -1383,18 +1526,54 @@ void III_reorder(mad_fixed_t xr[576], struct channel const *channel,
   memcpy(&xr[18 * sb], &tmp[sb], (576 - 18 * sb) * sizeof(mad_fixed_t));
 }
 
+/*
+ * NAME:	III_scale()
+ * DESCRIPTION:	multiply a run of frequency lines by a constant (dst may
+ *		be the same as src)
+ */
+static
+void III_scale(mad_fixed_t *dst, mad_fixed_t const *src,
+	       unsigned int n, mad_fixed_t scale)
+{
+  unsigned int i;
+
+  for (i = 0; i < n; ++i)
+    dst[i] = mad_f_mul(src[i], scale);
+}
+
+/*
+ * NAME:	III_midside()
+ * DESCRIPTION:	convert a run of middle/side lines to left/right
+ */
+static
+void III_midside(mad_fixed_t *left, mad_fixed_t *right, unsigned int n)
+{
+  mad_fixed_t const invsqrt2 = root_table[3 + -2];
+  unsigned int i;
+
+  for (i = 0; i < n; ++i) {
+    register mad_fixed_t m, s;
+
+    m = left[i];
+    s = right[i];
+
+    left[i]  = mad_f_mul(m + s, invsqrt2);  /* l = (m + s) / sqrt(2) */
+    right[i] = mad_f_mul(m - s, invsqrt2);  /* r = (m - s) / sqrt(2) */
+  }
+}
+
 /*
  * NAME:	III_stereo()
  * DESCRIPTION:	perform joint stereo processing on a granule
  */
 static
 enum mad_error III_stereo(mad_fixed_t xr[2][576],
-			  struct granule const *granule,
+			  struct granule *granule,
 			  struct mad_header *header,
 			  unsigned char const *sfbwidth)
 {
   short modes[39];
-  unsigned int sfbi, l, n, i;
+  unsigned int sfbi, l, n, i, extent[2];
 
   if (granule->ch[0].block_type !=
       granule->ch[1].block_type ||
@@ -1405,6 +1584,15 @@ enum mad_error III_stereo(mad_fixed_t xr[2][576],
   for (i = 0; i < 39; ++i)
     modes[i] = header->mode_extension;
 
+  /*
+   * Lines at or beyond each channel's rzero are known to be zero, and
+   * every mode below maps zero input to zero output, so there is no need
+   * to look at scalefactor bands beyond the nonzero extent.
+   */
+
+  extent[0] = granule->ch[0].rzero;
+  extent[1] = granule->ch[1].rzero;
+
   /* intensity stereo */
 
   if (header->mode_extension & I_STEREO) {
@@ -1442,7 +1630,7 @@ enum mad_error III_stereo(mad_fixed_t xr[2][576],
       }
 
       w = 0;
-      while (l < 576) {
+      while (l < extent[1]) {
 	n = sfbwidth[sfbi++];
 
 	for (i = 0; i < n; ++i) {
@@ -1479,7 +1667,7 @@ enum mad_error III_stereo(mad_fixed_t xr[2][576],
       unsigned int bound;
 
       bound = 0;
-      for (sfbi = l = 0; l < 576; l += n) {
+      for (sfbi = l = 0; l < extent[1]; l += n) {
 	n = sfbwidth[sfbi++];
 
 	for (i = 0; i < n; ++i) {
@@ -1505,7 +1693,7 @@ enum mad_error III_stereo(mad_fixed_t xr[2][576],
       /* intensity_scale */
       lsf_scale = is_lsf_table[right_ch->scalefac_compress & 0x1];
 
-      for (sfbi = l = 0; l < 576; ++sfbi, l += n) {
+      for (sfbi = l = 0; l < extent[0]; ++sfbi, l += n) {
 	n = sfbwidth[sfbi];
 
 	if (!(modes[sfbi] & I_STEREO))
@@ -1518,30 +1706,18 @@ enum mad_error III_stereo(mad_fixed_t xr[2][576],
 
 	is_pos = right_ch->scalefac[sfbi];
 
-	for (i = 0; i < n; ++i) {
-	  register mad_fixed_t left;
-
-	  left = xr[0][l + i];
-
-	  if (is_pos == 0)
-	    xr[1][l + i] = left;
-	  else {
-	    register mad_fixed_t opposite;
-
-	    opposite = mad_f_mul(left, lsf_scale[(is_pos - 1) / 2]);
-
-	    if (is_pos & 1) {
-	      xr[0][l + i] = opposite;
-	      xr[1][l + i] = left;
-	    }
-	    else
-	      xr[1][l + i] = opposite;
-	  }
+	if (is_pos == 0)
+	  memcpy(&xr[1][l], &xr[0][l], n * sizeof(mad_fixed_t));
+	else if (is_pos & 1) {
+	  memcpy(&xr[1][l], &xr[0][l], n * sizeof(mad_fixed_t));
+	  III_scale(&xr[0][l], &xr[0][l], n, lsf_scale[(is_pos - 1) / 2]);
 	}
+	else
+	  III_scale(&xr[1][l], &xr[0][l], n, lsf_scale[(is_pos - 1) / 2]);
       }
     }
     else {  /* !(header->flags & MAD_FLAG_LSF_EXT) */
-      for (sfbi = l = 0; l < 576; ++sfbi, l += n) {
+      for (sfbi = l = 0; l < extent[0]; ++sfbi, l += n) {
 	n = sfbwidth[sfbi];
 
 	if (!(modes[sfbi] & I_STEREO))
@@ -1554,43 +1730,41 @@ enum mad_error III_stereo(mad_fixed_t xr[2][576],
 	  continue;
 	}
 
-	for (i = 0; i < n; ++i) {
-	  register mad_fixed_t left;
-
-	  left = xr[0][l + i];
-
-	  xr[0][l + i] = mad_f_mul(left, is_table[    is_pos]);
-	  xr[1][l + i] = mad_f_mul(left, is_table[6 - is_pos]);
-	}
+	III_scale(&xr[1][l], &xr[0][l], n, is_table[6 - is_pos]);
+	III_scale(&xr[0][l], &xr[0][l], n, is_table[    is_pos]);
       }
     }
   }
 
+  /* the right channel now extends as far as the left, and vice versa */
+
+  if (extent[0] < extent[1])
+    extent[0] = extent[1];
+
+  granule->ch[0].rzero = granule->ch[1].rzero = extent[0];
+
   /* middle/side stereo */
 
   if (header->mode_extension & MS_STEREO) {
-    register mad_fixed_t invsqrt2;
+    unsigned int run;
 
     header->flags |= MAD_FLAG_MS_STEREO;
 
-    invsqrt2 = root_table[3 + -2];
+    /* process runs of adjacent middle/side bands at once */
 
-    for (sfbi = l = 0; l < 576; ++sfbi, l += n) {
+    for (sfbi = l = run = 0; l < extent[0]; ++sfbi, l += n) {
       n = sfbwidth[sfbi];
 
-      if (modes[sfbi] != MS_STEREO)
-	continue;
-
-      for (i = 0; i < n; ++i) {
-	register mad_fixed_t m, s;
-
-	m = xr[0][l + i];
-	s = xr[1][l + i];
-
-	xr[0][l + i] = mad_f_mul(m + s, invsqrt2);  /* l = (m + s) / sqrt(2) */
-	xr[1][l + i] = mad_f_mul(m - s, invsqrt2);  /* r = (m - s) / sqrt(2) */
+      if (modes[sfbi] == MS_STEREO)
+	run += n;
+      else if (run) {
+	III_midside(&xr[0][l - run], &xr[1][l - run], run);
+	run = 0;
       }
     }
+
+    if (run)
+      III_midside(&xr[0][l - run], &xr[1][l - run], run);
   }
 
   return MAD_ERROR_NONE;
@@ -1646,7 +1820,11 @@ void fastsdct(mad_fixed_t const x[9], mad_fixed_t y[17])  /* was y[18] */
   mad_fixed_t a13, a14, a15, a16, a17, a18, a19, a20, a21, a22, a23, a24, a25;
   mad_fixed_t m0,  m1,  m2,  m3,  m4,  m5,  m6,  m7;
 
+# if defined(FPM_FLOAT)
+  static mad_fixed_t const
+# else
   enum {
+# endif
     c0 =  MAD_F(0x1f838b8d),  /* 2 * cos( 1 * PI / 18) */
     c1 =  MAD_F(0x1bb67ae8),  /* 2 * cos( 3 * PI / 18) */
     c2 =  MAD_F(0x18836fa3),  /* 2 * cos( 4 * PI / 18) */
@@ -1654,7 +1832,11 @@ void fastsdct(mad_fixed_t const x[9], mad_fixed_t y[17])  /* was y[18] */
     c4 =  MAD_F(0x0af1d43a),  /* 2 * cos( 7 * PI / 18) */
     c5 =  MAD_F(0x058e86a0),  /* 2 * cos( 8 * PI / 18) */
     c6 = -MAD_F(0x1e11f642)   /* 2 * cos(16 * PI / 18) */
+# if defined(FPM_FLOAT)
+  ;
+# else
   };
+# endif
 
   a0 = x[3] + x[5];
   a1 = x[3] - x[5];
@@ -2371,6 +2553,44 @@ void III_overlap_z(mad_fixed_t overlap[18],
 # endif
 }
 
+/*
+ * NAME:	III_overlap_gain()
+ * DESCRIPTION:	perform overlap-add of windowed IMDCT outputs, scaling the
+ *		resulting subband samples by a gain with saturation
+ */
+static
+void III_overlap_gain(mad_fixed_t const output[36], mad_fixed_t overlap[18],
+		      mad_fixed_t sample[18][32], unsigned int sb,
+		      mad_fixed_t gain, mad_fixed_t limit)
+{
+  mad_fixed_t value;
+  unsigned int i;
+
+  for (i = 0; i < 18; ++i) {
+    value         = output[i + 0] + overlap[i];
+    sample[i][sb] = mad_gain_mul(value, gain, limit);
+    overlap[i]    = output[i + 18];
+  }
+}
+
+/*
+ * NAME:	III_overlap_z_gain()
+ * DESCRIPTION:	perform "overlap-add" of zero IMDCT outputs, scaling the
+ *		resulting subband samples by a gain with saturation
+ */
+static
+void III_overlap_z_gain(mad_fixed_t overlap[18],
+			mad_fixed_t sample[18][32], unsigned int sb,
+			mad_fixed_t gain, mad_fixed_t limit)
+{
+  unsigned int i;
+
+  for (i = 0; i < 18; ++i) {
+    sample[i][sb] = mad_gain_mul(overlap[i], gain, limit);
+    overlap[i]    = 0;
+  }
+}
+
 /*
  * NAME:	III_freqinver()
  * DESCRIPTION:	perform subband frequency inversion for odd sample lines
@@ -2405,17 +2625,217 @@ void III_freqinver(mad_fixed_t sample[18][32], unsigned int sb)
 # endif
 }
 
+/*
+ * NAME:	III_backend()
+ * DESCRIPTION:	reorder, alias reduce, IMDCT, overlap-add (applying any
+ *		subband gains) and frequency invert one channel of one granule
+ */
+static
+void III_backend(mad_fixed_t xr[576], struct channel const *channel,
+		 unsigned char const *sfbwidth, mad_fixed_t const *gain,
+		 mad_fixed_t const *limit,
+		 mad_fixed_t overlap[32][18], mad_fixed_t sample[18][32],
+		 struct mad_stats *stats)
+{
+  unsigned int sb, l, i, sblimit;
+  mad_fixed_t output[36];
+  STATS_LAP_DECL(lap)
+
+  STATS_LAP_START(lap, stats);
+
+  if (channel->block_type == 2) {
+    III_reorder(xr, channel, sfbwidth);
+
+# if !defined(OPT_STRICT)
+    /*
+     * According to ISO/IEC 11172-3, "Alias reduction is not applied for
+     * granules with block_type == 2 (short block)." However, other
+     * sources suggest alias reduction should indeed be performed on the
+     * lower two subbands of mixed blocks. Most other implementations do
+     * this, so by default we will too.
+     */
+    if (channel->flags & mixed_block_flag)
+      III_aliasreduce(xr, 36);
+# endif
+  }
+  else {
+    /*
+     * Butterflies straddling a subband boundary at or beyond rzero + 8
+     * only see zero lines, so stop there.
+     */
+    i = channel->rzero + 8;
+    if (i > 576)
+      i = 576;
+
+    III_aliasreduce(xr, i);
+  }
+
+  STATS_LAP(lap, MAD_STAGE_ALIAS);
+
+  l = 0;
+
+  /* subbands 0-1 */
+
+  if (channel->block_type != 2 || (channel->flags & mixed_block_flag)) {
+    unsigned int block_type;
+
+    block_type = channel->block_type;
+    if (channel->flags & mixed_block_flag)
+      block_type = 0;
+
+    /* long blocks */
+    for (sb = 0; sb < 2; ++sb, l += 18) {
+      III_imdct_l(&xr[l], output, block_type);
+      if (gain)
+	III_overlap_gain(output, overlap[sb], sample, sb,
+			 gain[sb], limit[sb]);
+      else
+	III_overlap(output, overlap[sb], sample, sb);
+    }
+  }
+  else {
+    /* short blocks */
+    for (sb = 0; sb < 2; ++sb, l += 18) {
+      III_imdct_s(&xr[l], output);
+      if (gain)
+	III_overlap_gain(output, overlap[sb], sample, sb,
+			 gain[sb], limit[sb]);
+      else
+	III_overlap(output, overlap[sb], sample, sb);
+    }
+  }
+
+  III_freqinver(sample, 1);
+
+  /* (nonzero) subbands 2-31 */
+
+  i = 576;
+  if (channel->block_type != 2 && channel->rzero + 15 < 576) {
+    /* alias reduction mirrors lines across the next subband boundary */
+    i = channel->rzero + 15;
+  }
+
+  while (i > 36 && xr[i - 1] == 0)
+    --i;
+
+  sblimit = 32 - (576 - i) / 18;
+
+  if (channel->block_type != 2) {
+    /* long blocks */
+    for (sb = 2; sb < sblimit; ++sb, l += 18) {
+      III_imdct_l(&xr[l], output, channel->block_type);
+      if (gain)
+	III_overlap_gain(output, overlap[sb], sample, sb,
+			 gain[sb], limit[sb]);
+      else
+	III_overlap(output, overlap[sb], sample, sb);
+
+      if (sb & 1)
+	III_freqinver(sample, sb);
+    }
+  }
+  else {
+    /* short blocks */
+    for (sb = 2; sb < sblimit; ++sb, l += 18) {
+      III_imdct_s(&xr[l], output);
+      if (gain)
+	III_overlap_gain(output, overlap[sb], sample, sb,
+			 gain[sb], limit[sb]);
+      else
+	III_overlap(output, overlap[sb], sample, sb);
+
+      if (sb & 1)
+	III_freqinver(sample, sb);
+    }
+  }
+
+  /* remaining (zero) subbands */
+
+  for (sb = sblimit; sb < 32; ++sb) {
+    if (gain)
+      III_overlap_z_gain(overlap[sb], sample, sb, gain[sb], limit[sb]);
+    else
+      III_overlap_z(overlap[sb], sample, sb);
+
+    if (sb & 1)
+      III_freqinver(sample, sb);
+  }
+
+  STATS_LAP(lap, MAD_STAGE_IMDCT);
+}
+
+struct backend {
+  struct mad_job job;
+  mad_fixed_t *xr;
+  struct channel const *channel;
+  unsigned char const *sfbwidth;
+  mad_fixed_t const *gain;
+  mad_fixed_t const *limit;
+  mad_fixed_t (*overlap)[18];
+  mad_fixed_t (*sample)[32];
+  struct mad_stats *stats;
+};
+
+/*
+ * A frame with a backend store only has its front end (through joint
+ * stereo processing) run by mad_layer_III(); the spectrum is kept here until
+ * mad_layer_III_backend() produces the subband samples, so that batched
+ * decoding can run each stage over several frames in turn.
+ */
+
+struct mad_backend {
+  unsigned int ngr;			/* granules decoded */
+  unsigned int nch;			/* channels */
+
+  struct granule gr[2];
+  unsigned char const *sfbwidth[2][2];
+  struct mad_gain_block const *gain[2];	/* subband gains, if any */
+
+  mad_fixed_t xr[2][2][576];
+  struct mad_gain_block gains[2];
+};
+
+/*
+ * NAME:	III_backend_job()
+ * DESCRIPTION:	run III_backend() on a worker thread
+ */
+static
+void III_backend_job(void *data, unsigned int worker)
+{
+  struct backend *backend = data;
+
+  (void) worker;
+
+  III_backend(backend->xr, backend->channel, backend->sfbwidth,
+	      backend->gain, backend->limit, backend->overlap,
+	      backend->sample, backend->stats);
+}
+
 /*
  * NAME:	III_decode()
  * DESCRIPTION:	decode frame main_data
  */
 static
 enum mad_error III_decode(struct mad_bitptr *ptr, struct mad_frame *frame,
-			  struct sideinfo *si, unsigned int nch, unsigned int md_len)
+			  struct sideinfo *si, unsigned int nch, unsigned int md_len,
+			  struct mad_stats *stats)
 {
   struct mad_header *header = &frame->header;
   unsigned int sfreqi, ngr, gr;
   int bits_left = md_len * CHAR_BIT;
+  mad_fixed_t spectrum[2][2][576], (*xr)[2][576];
+  struct mad_gain_block scaling[2], *gains;
+  struct mad_gain_block const *gain;
+  struct mad_backend *deferred;
+  struct backend async;
+  int pending = 0;
+  enum mad_error error = MAD_ERROR_NONE;
+  STATS_LAP_DECL(lap)
+# if defined(OPT_STATS)
+  struct mad_stats async_stats;
+# endif
+
+  STATS_LAP_START(lap, stats);
 
   {
     unsigned int sfreq;
@@ -2433,6 +2853,30 @@ enum mad_error III_decode(struct mad_bitptr *ptr, struct mad_frame *frame,
       sfreqi += 3;
   }
 
+  xr    = spectrum;
+  gains = scaling;
+
+  deferred = frame->backend;
+  if (deferred) {
+    xr    = deferred->xr;
+    gains = deferred->gains;
+
+    deferred->ngr = 0;
+    deferred->nch = nch;
+  }
+
+  async.job.func = III_backend_job;
+  async.job.data = &async;
+  async.stats    = 0;
+
+# if defined(OPT_STATS)
+  /* the worker keeps its own stage times, merged once it is idle */
+  if (stats) {
+    memset(&async_stats, 0, sizeof(async_stats));
+    async.stats = &async_stats;
+  }
+# endif
+
   /* scalefactors, Huffman decoding, requantization */
 
   ngr = (header->flags & MAD_FLAG_LSF_EXT) ? 1 : 2;
@@ -2440,9 +2884,7 @@ enum mad_error III_decode(struct mad_bitptr *ptr, struct mad_frame *frame,
   for (gr = 0; gr < ngr; ++gr) {
     struct granule *granule = &si->gr[gr];
     unsigned char const *sfbwidth[2];
-    mad_fixed_t xr[2][576];
-    unsigned int ch;
-    enum mad_error error;
+    unsigned int ch, nsync;
 
     for (ch = 0; ch < nch; ++ch) {
       struct channel *channel = &granule->ch[ch];
@@ -2465,125 +2907,131 @@ enum mad_error III_decode(struct mad_bitptr *ptr, struct mad_frame *frame,
 					gr == 0 ? 0 : si->scfsi[ch], bits_left, &part2_length);
       }
       if (error)
-        return error;
+        goto done;
+
+      STATS_LAP(lap, MAD_STAGE_SCALEFACTORS);
 
       bits_left -= part2_length;
 
-      if (part2_length > channel->part2_3_length)
-        return MAD_ERROR_BADPART3LEN;
+      if (part2_length > channel->part2_3_length) {
+	error = MAD_ERROR_BADPART3LEN;
+	goto done;
+      }
 
       part3_length = channel->part2_3_length - part2_length;
-      if (part3_length > bits_left)
-        return MAD_ERROR_BADPART3LEN;
+      if (part3_length > bits_left) {
+	error = MAD_ERROR_BADPART3LEN;
+	goto done;
+      }
 
-      error = III_huffdecode(ptr, xr[ch], channel, sfbwidth[ch], part3_length);
+      error = III_huffdecode(ptr, xr[gr][ch], channel, sfbwidth[ch],
+			     part3_length);
       if (error)
-	return error;
+	goto done;
       bits_left -= part3_length;
+
+      STATS_LAP(lap, MAD_STAGE_HUFFMAN);
     }
 
     /* joint stereo processing */
 
     if (header->mode == MAD_MODE_JOINT_STEREO && header->mode_extension) {
-      error = III_stereo(xr, granule, header, sfbwidth[0]);
+      error = III_stereo(xr[gr], granule, header, sfbwidth[0]);
       if (error)
-	return error;
-    }
-
-    /* reordering, alias reduction, IMDCT, overlap-add, frequency inversion */
+	goto done;
 
-    for (ch = 0; ch < nch; ++ch) {
-      struct channel const *channel = &granule->ch[ch];
-      mad_fixed_t (*sample)[32] = &frame->sbsample[ch][18 * gr];
-      unsigned int sb, l, i, sblimit;
-      mad_fixed_t output[36];
+      STATS_LAP(lap, MAD_STAGE_STEREO);
+    }
 
-      if (channel->block_type == 2) {
-	III_reorder(xr[ch], channel, sfbwidth[ch]);
+    /*
+     * The subband gains of each granule, and their limits, are copied, as
+     * the back end may still be running (or not yet have run) when the
+     * next step is taken.
+     */
 
-# if !defined(OPT_STRICT)
-	/*
-	 * According to ISO/IEC 11172-3, "Alias reduction is not applied for
-	 * granules with block_type == 2 (short block)." However, other
-	 * sources suggest alias reduction should indeed be performed on the
-	 * lower two subbands of mixed blocks. Most other implementations do
-	 * this, so by default we will too.
-	 */
-	if (channel->flags & mixed_block_flag)
-	  III_aliasreduce(xr[ch], 36);
-# endif
-      }
-      else
-	III_aliasreduce(xr[ch], 576);
+    gain = frame->gain ? mad_gain_step(frame->gain, 18) : 0;
+    if (gain) {
+      gains[gr] = *gain;
+      gain = &gains[gr];
+    }
 
-      l = 0;
+    if (deferred) {
+      deferred->gr[gr] = *granule;
+      for (ch = 0; ch < nch; ++ch)
+	deferred->sfbwidth[gr][ch] = sfbwidth[ch];
 
-      /* subbands 0-1 */
+      deferred->gain[gr] = gain;
 
-      if (channel->block_type != 2 || (channel->flags & mixed_block_flag)) {
-	unsigned int block_type;
+      deferred->ngr = gr + 1;
 
-	block_type = channel->block_type;
-	if (channel->flags & mixed_block_flag)
-	  block_type = 0;
+      continue;
+    }
 
-	/* long blocks */
-	for (sb = 0; sb < 2; ++sb, l += 18) {
-	  III_imdct_l(&xr[ch][l], output, block_type);
-	  III_overlap(output, (*frame->overlap)[ch][sb], sample, sb);
-	}
-      }
-      else {
-	/* short blocks */
-	for (sb = 0; sb < 2; ++sb, l += 18) {
-	  III_imdct_s(&xr[ch][l], output);
-	  III_overlap(output, (*frame->overlap)[ch][sb], sample, sb);
-	}
-      }
+    /* reordering, alias reduction, IMDCT, overlap-add, frequency inversion */
 
-      III_freqinver(sample, 1);
+    if (pending) {
+      mad_pool_wait(frame->pool);
+      pending = 0;
 
-      /* (nonzero) subbands 2-31 */
+      STATS_LAP_START(lap, stats);
+    }
 
-      i = 576;
-      while (i > 36 && xr[ch][i - 1] == 0)
-	--i;
+    nsync = nch;
+
+    if (frame->pool && (nch == 2 || gr + 1 < ngr)) {
+      /*
+       * Hand the last channel to a worker. Its overlap is only needed
+       * again by the same channel of the next granule, so the wait can be
+       * deferred until then, overlapping it with the next granule's
+       * Huffman decoding.
+       */
+      nsync = nch - 1;
+
+      async.xr       = xr[gr][nsync];
+      async.channel  = &granule->ch[nsync];
+      async.sfbwidth = sfbwidth[nsync];
+      async.gain     = gain ? gain->gain[nsync]  : 0;
+      async.limit    = gain ? gain->limit[nsync] : 0;
+      async.overlap  = (*frame->overlap)[nsync];
+      async.sample   = &frame->sbsample[nsync][18 * gr];
+
+      mad_pool_submit(frame->pool, &async.job);
+      pending = 1;
+    }
 
-      sblimit = 32 - (576 - i) / 18;
+    for (ch = 0; ch < nsync; ++ch) {
+      III_backend(xr[gr][ch], &granule->ch[ch], sfbwidth[ch],
+		  gain ? gain->gain[ch] : 0, gain ? gain->limit[ch] : 0,
+		  (*frame->overlap)[ch], &frame->sbsample[ch][18 * gr], stats);
+    }
 
-      if (channel->block_type != 2) {
-	/* long blocks */
-	for (sb = 2; sb < sblimit; ++sb, l += 18) {
-	  III_imdct_l(&xr[ch][l], output, channel->block_type);
-	  III_overlap(output, (*frame->overlap)[ch][sb], sample, sb);
+    /*
+     * The subband samples of this granule are now final, so they can be
+     * passed on before the next granule is even Huffman decoded.
+     */
 
-	  if (sb & 1)
-	    III_freqinver(sample, sb);
-	}
+    if (frame->granule_func) {
+      if (pending) {
+	mad_pool_wait(frame->pool);
+	pending = 0;
       }
-      else {
-	/* short blocks */
-	for (sb = 2; sb < sblimit; ++sb, l += 18) {
-	  III_imdct_s(&xr[ch][l], output);
-	  III_overlap(output, (*frame->overlap)[ch][sb], sample, sb);
 
-	  if (sb & 1)
-	    III_freqinver(sample, sb);
-	}
-      }
+      frame->granule_func(frame->granule_data, frame, gr);
+    }
 
-      /* remaining (zero) subbands */
+    STATS_LAP_START(lap, stats);
+  }
 
-      for (sb = sblimit; sb < 32; ++sb) {
-	III_overlap_z((*frame->overlap)[ch][sb], sample, sb);
+ done:
+  if (pending)
+    mad_pool_wait(frame->pool);
 
-	if (sb & 1)
-	  III_freqinver(sample, sb);
-      }
-    }
-  }
+# if defined(OPT_STATS)
+  if (stats)
+    mad_stats_merge(stats, &async_stats);
+# endif
 
-  return MAD_ERROR_NONE;
+  return error;
 }
 
 /*
@@ -2600,13 +3048,16 @@ int mad_layer_III(struct mad_stream *stream, struct mad_frame *frame)
   struct sideinfo si;
   enum mad_error error;
   int result = 0;
+  STATS_LAP_DECL(lap)
+
+  STATS_LAP_START(lap, stream->stats);
 
   mad_bit_init(&bufend_ptr, stream->bufend);
 
   /* allocate Layer III dynamic structures */
 
   if (stream->main_data == 0) {
-    stream->main_data = malloc(MAD_BUFFER_MDLEN);
+    stream->main_data = mad_alloc(stream->allocator, MAD_BUFFER_MDLEN);
     if (stream->main_data == 0) {
       stream->error = MAD_ERROR_NOMEM;
       return -1;
@@ -2614,13 +3065,20 @@ int mad_layer_III(struct mad_stream *stream, struct mad_frame *frame)
   }
 
   if (frame->overlap == 0) {
-    frame->overlap = calloc(2 * 32 * 18, sizeof(mad_fixed_t));
+    frame->overlap = mad_alloc(stream->allocator, sizeof(*frame->overlap));
     if (frame->overlap == 0) {
       stream->error = MAD_ERROR_NOMEM;
       return -1;
     }
+
+    memset(frame->overlap, 0, sizeof(*frame->overlap));
   }
 
+  /* a missing worker thread is not fatal; III_decode() runs serially */
+
+  if ((frame->options & MAD_OPTION_THREADED) && frame->pool == 0)
+    frame->pool = mad_pool_create(1);
+
   nch = MAD_NCHANNELS(header);
   si_len = (header->flags & MAD_FLAG_LSF_EXT) ?
     (nch == 1 ? 9 : 17) : (nch == 1 ? 17 : 32);
@@ -2647,6 +3105,8 @@ int mad_layer_III(struct mad_stream *stream, struct mad_frame *frame)
     }
   }
 
+  STATS_LAP(lap, MAD_STAGE_CRC);
+
   /* decode frame side information */
 
   error = III_sideinfo(&stream->ptr, nch, header->flags & MAD_FLAG_LSF_EXT,
@@ -2730,15 +3190,19 @@ int mad_layer_III(struct mad_stream *stream, struct mad_frame *frame)
 
   frame_free = frame_space - frame_used;
 
+  STATS_LAP(lap, MAD_STAGE_SIDEINFO);
+
   /* decode main_data */
 
   if (result == 0) {
-    error = III_decode(&ptr, frame, &si, nch, md_len);
+    error = III_decode(&ptr, frame, &si, nch, md_len, stream->stats);
     if (error) {
       stream->error = error;
       result = -1;
     }
 
+    STATS_LAP_START(lap, stream->stats);
+
     /* designate ancillary bits */
 
     stream->anc_ptr    = ptr;
@@ -2782,5 +3246,179 @@ int mad_layer_III(struct mad_stream *stream, struct mad_frame *frame)
     stream->md_len += frame_free;
   }
 
+  STATS_LAP(lap, MAD_STAGE_SIDEINFO);
+
   return result;
 }
+
+/*
+ * NAME:	layer->III_defer()
+ * DESCRIPTION:	allocate a store for deferring the Layer III back end
+ */
+struct mad_backend *mad_layer_III_defer(struct mad_allocator const *allocator)
+{
+  struct mad_backend *backend;
+
+  backend = mad_alloc(allocator, sizeof(*backend));
+  if (backend) {
+    backend->ngr = 0;
+    backend->nch = 0;
+  }
+
+  return backend;
+}
+
+/*
+ * NAME:	layer->III_backend()
+ * DESCRIPTION:	run the deferred Layer III back end of a decoded frame
+ */
+void mad_layer_III_backend(struct mad_frame *frame, struct mad_stats *stats)
+{
+  struct mad_backend *backend = frame->backend;
+  unsigned int gr, ch;
+
+  for (gr = 0; gr < backend->ngr; ++gr) {
+    for (ch = 0; ch < backend->nch; ++ch) {
+      III_backend(backend->xr[gr][ch], &backend->gr[gr].ch[ch],
+		  backend->sfbwidth[gr][ch],
+		  backend->gain[gr] ? backend->gain[gr]->gain[ch]  : 0,
+		  backend->gain[gr] ? backend->gain[gr]->limit[ch] : 0,
+		  (*frame->overlap)[ch],
+		  &frame->sbsample[ch][18 * gr], stats);
+    }
+  }
+}
+
+/*
+ * NAME:	layer->III_bands()
+ * DESCRIPTION:	compute the subband energies of a deferred frame from its
+ *		requantized spectrum; return the number of granules
+ */
+unsigned int mad_layer_III_bands(struct mad_frame const *frame,
+				 mad_fixed_t energy[3][2][32])
+{
+  struct mad_backend const *backend = frame->backend;
+  mad_fixed_t const long_scale  = MAD_F_ONE / 2;
+  mad_fixed_t const short_scale = MAD_F_ONE / 6;
+  unsigned int gr, ch, sb, l, f, w, sbw[3];
+  unsigned char const *sfbwidth;
+  mad_fixed_t const *xr;
+  mad_fixed_t *band;
+
+  /*
+   * The unnormalized IMDCT of N/2 lines yields N/4 times their energy in
+   * the subband samples (N = 36 for long blocks, 12 for short), so each
+   * square is weighted by that gain over the 18 samples of a granule to
+   * give the same mean squares as mad_bands_frame(). Energy that windowing
+   * and overlap-add move between granules, and that alias reduction moves
+   * between subbands, is not accounted for.
+   */
+
+  for (gr = 0; gr < backend->ngr; ++gr) {
+    for (ch = 0; ch < backend->nch; ++ch) {
+      struct channel const *channel = &backend->gr[gr].ch[ch];
+
+      xr       = backend->xr[gr][ch];
+      sfbwidth = backend->sfbwidth[gr][ch];
+      band     = energy[gr][ch];
+
+      for (sb = 0; sb < 32; ++sb)
+	band[sb] = 0;
+
+      /* long blocks, and the long part of mixed blocks */
+
+      l = 576;
+      if (channel->block_type == 2) {
+	l = 0;
+	if (channel->flags & mixed_block_flag) {
+	  while (l < 36)
+	    l += *sfbwidth++;
+	}
+      }
+
+      for (f = 0; f < l; ++f)
+	band[f / 18] += mad_f_mul(xr[f], mad_f_mul(xr[f], long_scale));
+
+      if (l == 576)
+	continue;
+
+      /* short blocks, walked in the same order as III_reorder() */
+
+      for (w = 0; w < 3; ++w)
+	sbw[w] = 6 * (l / 18);
+
+      f = *sfbwidth++;
+      w = 0;
+
+      for (; l < 576; ++l) {
+	if (f-- == 0) {
+	  f = *sfbwidth++ - 1;
+	  w = (w + 1) % 3;
+	}
+
+	band[sbw[w]++ / 6] += mad_f_mul(xr[l], mad_f_mul(xr[l], short_scale));
+      }
+    }
+  }
+
+  return backend->ngr;
+}
+
+# if defined(FPM_FLOAT)
+/*
+ * NAME:	layer3->init_tables()
+ * DESCRIPTION:	compute the Layer III tables in double precision
+ */
+void mad_layer3_init_tables(void)
+{
+  static int done;
+  static double const c[8] = {
+    -0.6, -0.535, -0.33, -0.185, -0.095, -0.041, -0.0142, -0.0037
+  };
+  double const pi = 3.14159265358979323846;
+  unsigned int i, k, n;
+
+  if (done)
+    return;
+
+  for (i = 0; i < RQ_TABLE_SIZE; ++i)
+    rq_table[i] = pow(i, 4.0 / 3);
+
+  for (i = 0; i < 7; ++i)
+    root_table[i] = pow(2, ((signed int) i - 3) / 4.0);
+
+  for (i = 0; i < 8; ++i) {
+    cs[i] =    1 / sqrt(1 + c[i] * c[i]);
+    ca[i] = c[i] / sqrt(1 + c[i] * c[i]);
+  }
+
+  /* imdct_s[] rows are stored in the order 0, 6, 1, 7, 2, 8 */
+
+  for (i = 0; i < 6; ++i) {
+    n = (i % 2) ? 6 + i / 2 : i / 2;
+
+    for (k = 0; k < 6; ++k)
+      imdct_s[i][k] = cos(pi / 24 * (2 * n + 7) * (2 * k + 1));
+  }
+
+#  if !defined(ASO_IMDCT)
+  for (i = 0; i < 36; ++i)
+    window_l[i] = sin(pi / 36 * (i + 0.5));
+#  endif
+
+  for (i = 0; i < 12; ++i)
+    window_s[i] = sin(pi / 12 * (i + 0.5));
+
+  /* tan(x) / (1 + tan(x)), written so that is_table[6] is exactly 1 */
+
+  for (i = 0; i < 7; ++i)
+    is_table[i] = sin(i * pi / 12) / (sin(i * pi / 12) + cos(i * pi / 12));
+
+  for (i = 0; i < 15; ++i) {
+    is_lsf_table[0][i] = pow(2, -(i + 1.0) / 4);
+    is_lsf_table[1][i] = pow(2, -(i + 1.0) / 2);
+  }
+
+  done = 1;
+}
+# endif
@@ -27,4 +27,13 @@
 
 int mad_layer_III(struct mad_stream *, struct mad_frame *);
 
+struct mad_backend *mad_layer_III_defer(struct mad_allocator const *);
+void mad_layer_III_backend(struct mad_frame *, struct mad_stats *);
+unsigned int mad_layer_III_bands(struct mad_frame const *,
+				 mad_fixed_t [3][2][32]);
+
+# if defined(FPM_FLOAT)
+void mad_layer3_init_tables(void);
+# endif
+
 # endif
@@ -107,6 +107,19 @@ enum mad_flow input(void *data,
 static inline
 signed int scale(mad_fixed_t sample)
 {
+# if defined(FPM_FLOAT)
+  /* scale and round */
+  sample = sample * 32768 + (sample < 0 ? -0.5 : 0.5);
+
+  /* clip */
+  if (sample >= 32767)
+    return 32767;
+  else if (sample < -32768)
+    return -32768;
+
+  /* quantize */
+  return (signed int) sample;
+# else
   /* round */
   sample += (1L << (MAD_F_FRACBITS - 16));
 
@@ -118,6 +131,7 @@ signed int scale(mad_fixed_t sample)
 
   /* quantize */
   return sample >> (MAD_F_FRACBITS + 1 - 16);
+# endif
 }
 
 /*
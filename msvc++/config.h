@@ -76,6 +76,9 @@
 /* Define to optimize for accuracy over speed. */
 /* #undef OPT_ACCURACY */
 
+/* Define to use a compact requantization table, computing large values. */
+/* #undef OPT_COMPACT_RQ */
+
 /* Define to optimize for speed over accuracy. */
 /* #undef OPT_SPEED */
 
@@ -87,6 +87,18 @@ LIB32=link.exe -lib
 # PROP Default_Filter "c"
 # Begin Source File
 
+SOURCE=..\alloc.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\bands.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\batch.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\bit.c
 # End Source File
 # Begin Source File
@@ -103,6 +115,10 @@ SOURCE=..\frame.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\gain.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\huffman.c
 # End Source File
 # Begin Source File
@@ -115,6 +131,18 @@ SOURCE=..\layer3.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\pool.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\state.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\stats.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\stream.c
 # End Source File
 # Begin Source File
@@ -135,6 +163,18 @@ SOURCE=..\version.c
 # PROP Default_Filter "h"
 # Begin Source File
 
+SOURCE=..\alloc.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\bands.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\batch.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\bit.h
 # End Source File
 # Begin Source File
@@ -159,6 +199,10 @@ SOURCE=..\global.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\gain.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\huffman.h
 # End Source File
 # Begin Source File
@@ -171,6 +215,18 @@ SOURCE=..\layer3.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\pool.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\state.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\stats.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\stream.h
 # End Source File
 # Begin Source File
@@ -195,6 +251,14 @@ SOURCE=..\D.dat
 # End Source File
 # Begin Source File
 
+SOURCE=..\dct32.dat
+# End Source File
+# Begin Source File
+
+SOURCE=..\fl_table.dat
+# End Source File
+# Begin Source File
+
 SOURCE=..\imdct_s.dat
 # End Source File
 # Begin Source File
@@ -72,7 +72,12 @@ extern char const mad_build[];
 #  define INT_MAX 2147483647
 # endif
 
-# if INT_MAX >= 2147483647
+# if defined(FPM_FLOAT)
+typedef double mad_fixed_t;
+
+typedef double mad_fixed64hi_t;
+typedef double mad_fixed64lo_t;
+# elif INT_MAX >= 2147483647
 typedef   signed int mad_fixed_t;
 
 typedef   signed int mad_fixed64hi_t;
@@ -159,10 +164,32 @@ typedef mad_fixed_t mad_sample_t;
 # define mad_f_sub(x, y)	((x) - (y))
 
 # if defined(FPM_FLOAT)
-#  error "FPM_FLOAT not yet supported"
 
+/*
+ * This version is not fixed-point at all: values are doubles with the same
+ * scale (1.0 == MAD_F_ONE), and the decoding tables are computed when a
+ * frame or synth is first initialized. It is much slower than the other
+ * versions and is meant to serve as a reference for their accuracy.
+ */
 #  undef MAD_F
-#  define MAD_F(x)		mad_f_todouble(x)
+#  define MAD_F(x)		((mad_fixed_t) (x##L) / (1L << 28))
+
+#  undef MAD_F_MIN
+#  undef MAD_F_MAX
+#  define MAD_F_MIN		MAD_F(-0x80000000)
+#  define MAD_F_MAX		MAD_F(+0x7fffffff)
+
+#  undef mad_f_tofixed
+#  undef mad_f_todouble
+#  define mad_f_tofixed(x)	((mad_fixed_t) (x))
+#  define mad_f_todouble(x)	((double) (x))
+
+#  undef mad_f_intpart
+#  undef mad_f_fracpart
+#  undef mad_f_fromint
+#  define mad_f_intpart(x)	((long) (x))
+#  define mad_f_fracpart(x)	((x) - (long) (x))
+#  define mad_f_fromint(x)	((mad_fixed_t) (x))
 
 #  define mad_f_mul(x, y)	((x) * (y))
 #  define mad_f_scale64
@@ -628,6 +655,15 @@ typedef struct {
 
 extern mad_timer_t const mad_timer_zero;
 
+# if defined(_MSC_VER)
+typedef unsigned __int64 mad_samples_t;
+# elif defined(__GNUC__) ||  \
+      (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L)
+typedef unsigned long long mad_samples_t;
+# else
+typedef unsigned long mad_samples_t;
+# endif
+
 # define MAD_TIMER_RESOLUTION	352800000UL
 
 enum mad_units {
@@ -690,6 +726,7 @@ mad_timer_t mad_timer_abs(mad_timer_t);
 void mad_timer_set(mad_timer_t *, unsigned long, unsigned long, unsigned long);
 void mad_timer_add(mad_timer_t *, mad_timer_t);
 void mad_timer_multiply(mad_timer_t *, signed long);
+void mad_timer_samples(mad_timer_t *, mad_samples_t, unsigned long);
 
 signed long mad_timer_count(mad_timer_t, enum mad_units);
 unsigned long mad_timer_fraction(mad_timer_t, unsigned long);
@@ -738,6 +775,14 @@ enum mad_error {
 
 # define MAD_RECOVERABLE(error)	((error) & 0xff00)
 
+struct mad_allocator {
+  void *(*alloc)(void *, unsigned long);	/* allocate (data, size) */
+  void (*free)(void *, void *);		/* release (data, pointer) */
+  void *data;				/* allocator context */
+};
+
+struct mad_stats;
+
 struct mad_stream {
   unsigned char const *buffer;		/* input bitstream buffer */
   unsigned char const *bufend;		/* end of buffer */
@@ -745,6 +790,7 @@ struct mad_stream {
 
   int sync;				/* stream sync found */
   unsigned long freerate;		/* free bitrate (fixed) */
+  mad_samples_t samples;		/* PCM samples in decoded headers */
 
   unsigned char const *this_frame;	/* start of current frame */
   unsigned char const *next_frame;	/* start of next frame */
@@ -756,6 +802,8 @@ struct mad_stream {
   unsigned char (*main_data)[MAD_BUFFER_MDLEN];
 					/* Layer III main_data() */
   unsigned int md_len;			/* bytes in main_data */
+  struct mad_allocator const *allocator;/* dynamic buffers (0 = default) */
+  struct mad_stats *stats;		/* stage timing (0 = none) */
 
   int options;				/* decoding options (see below) */
   enum mad_error error;			/* error code (see above) */
@@ -763,7 +811,9 @@ struct mad_stream {
 
 enum {
   MAD_OPTION_IGNORECRC      = 0x0001,	/* ignore CRC errors */
-  MAD_OPTION_HALFSAMPLERATE = 0x0002	/* generate PCM at 1/2 sample rate */
+  MAD_OPTION_HALFSAMPLERATE = 0x0002,	/* generate PCM at 1/2 sample rate */
+  MAD_OPTION_THREADED       = 0x0004,	/* use a worker thread for Layer III */
+  MAD_OPTION_GRANULES       = 0x0008	/* output Layer III PCM per granule */
 # if 0  /* not yet implemented */
   MAD_OPTION_LEFTCHANNEL    = 0x0010,	/* decode left channel only */
   MAD_OPTION_RIGHTCHANNEL   = 0x0020,	/* decode right channel only */
@@ -771,6 +821,15 @@ enum {
 # endif
 };
 
+/*
+ * With MAD_OPTION_GRANULES, mad_decoder_run() calls the output callback once
+ * per Layer III granule with 576 samples per channel (288 at half sample
+ * rate) instead of once per frame, and calls the filter callback once per
+ * frame before its first granule, when only sbsample[ch][0..17] are valid.
+ */
+
+void mad_allocator_set(struct mad_allocator const *);
+
 void mad_stream_init(struct mad_stream *);
 void mad_stream_finish(struct mad_stream *);
 
@@ -793,6 +852,10 @@ char const *mad_stream_errorstr(struct mad_stream const *);
 # define LIBMAD_FRAME_H
 
 
+struct mad_pool;
+struct mad_backend;
+struct mad_gain;
+
 enum mad_layer {
   MAD_LAYER_I   = 1,			/* Layer I */
   MAD_LAYER_II  = 2,			/* Layer II */
@@ -838,6 +901,15 @@ struct mad_frame {
 
   mad_fixed_t sbsample[2][36][32];	/* synthesis subband filter samples */
   mad_fixed_t (*overlap)[2][32][18];	/* Layer III block overlap data */
+
+  struct mad_pool *pool;		/* Layer III worker thread, if any */
+
+  void (*granule_func)(void *, struct mad_frame *, unsigned int);
+  void *granule_data;			/* Layer III granule callback, if any */
+
+  struct mad_backend *backend;		/* deferred Layer III back end, if any */
+
+  struct mad_gain *gain;		/* subband gains, if any */
 };
 
 # define MAD_NCHANNELS(header)		((header)->mode ? 2 : 1)
@@ -897,6 +969,8 @@ struct mad_pcm {
   mad_fixed_t samples[2][1152];		/* PCM output samples [ch][sample] */
 };
 
+struct mad_stats;
+
 struct mad_synth {
   mad_fixed_t filter[2][2][2][16][8];	/* polyphase filterbank outputs */
   					/* [ch][eo][peo][s][v] */
@@ -904,6 +978,26 @@ struct mad_synth {
   unsigned int phase;			/* current processing phase */
 
   struct mad_pcm pcm;			/* PCM output */
+
+  struct mad_stats *stats;		/* stage timing (0 = none) */
+};
+
+struct mad_peak {
+  mad_fixed_t min;			/* lowest sample */
+  mad_fixed_t max;			/* highest sample */
+  mad_fixed_t energy;			/* mean square */
+};
+
+struct mad_peaks {
+  unsigned int length;			/* samples per bucket */
+  unsigned int step;			/* synthesize 1 in step samples */
+
+  struct mad_peak (*bucket)[2];		/* complete buckets [n][ch] */
+  unsigned int size;			/* number of buckets allocated */
+  unsigned int count;			/* number of buckets completed */
+
+  unsigned int fill;			/* samples in the current bucket */
+  struct mad_peak current[2];		/* bucket being accumulated [ch] */
 };
 
 /* single channel PCM selector */
@@ -930,6 +1024,125 @@ void mad_synth_init(struct mad_synth *);
 void mad_synth_mute(struct mad_synth *);
 
 void mad_synth_frame(struct mad_synth *, struct mad_frame const *);
+void mad_synth_frames(struct mad_synth *, struct mad_frame const *,
+		      unsigned int, struct mad_pcm *);
+void mad_synth_granule(struct mad_synth *, struct mad_frame const *,
+		       unsigned int);
+void mad_synth_frame_multi(struct mad_synth *[],
+			   struct mad_frame const *[], unsigned int);
+
+void mad_peaks_init(struct mad_peaks *, unsigned int, unsigned int,
+		    struct mad_peak (*)[2], unsigned int);
+void mad_synth_peaks(struct mad_synth *, struct mad_frame const *,
+		     struct mad_peaks *);
+
+# endif
+
+
+# ifndef LIBMAD_STATE_H
+# define LIBMAD_STATE_H
+
+
+struct mad_state {
+  struct mad_stream stream;		/* bitstream and Layer III reservoir */
+
+  mad_fixed_t (*overlap)[2][32][18];	/* Layer III block overlap data */
+  mad_fixed_t (*filter)[2][2][2][16][8];
+					/* polyphase filterbank outputs */
+  unsigned int phase;			/* synthesis processing phase */
+};
+
+void mad_state_init(struct mad_state *);
+void mad_state_finish(struct mad_state *);
+
+int mad_state_attach(struct mad_state *, struct mad_frame *,
+		     struct mad_synth *);
+void mad_state_detach(struct mad_state *, struct mad_frame *,
+		      struct mad_synth *);
+
+int mad_state_decode(struct mad_state *, struct mad_frame *,
+		     struct mad_synth *);
+
+# endif
+
+
+# ifndef LIBMAD_BATCH_H
+# define LIBMAD_BATCH_H
+
+
+struct mad_batch {
+  unsigned int size;			/* number of frames allocated */
+  struct mad_frame *frames;		/* frames decoded together */
+};
+
+void mad_batch_init(struct mad_batch *);
+void mad_batch_finish(struct mad_batch *);
+
+unsigned int mad_batch_decode(struct mad_batch *, struct mad_stream *,
+			      struct mad_frame *, struct mad_synth *,
+			      struct mad_pcm *, unsigned int);
+
+# endif
+
+
+# ifndef LIBMAD_BANDS_H
+# define LIBMAD_BANDS_H
+
+
+struct mad_bands {
+  unsigned short granules;		/* number of granules */
+  unsigned short channels;		/* number of channels */
+  unsigned short length;		/* samples per channel per granule */
+  mad_fixed_t energy[3][2][32];		/* mean square [gr][ch][sb] */
+};
+
+void mad_bands_frame(struct mad_bands *, struct mad_frame const *);
+
+# endif
+
+
+# ifndef LIBMAD_GAIN_H
+# define LIBMAD_GAIN_H
+
+
+/* largest subband gain (just under +12 dB) */
+# define MAD_GAIN_MAX		MAD_F(0x3fffffff)
+
+struct mad_gain_block {
+  mad_fixed_t gain[2][32];		/* gains of a block [ch][sb] */
+  mad_fixed_t limit[2][32];		/* largest unsaturated samples */
+};
+
+struct mad_gain {
+  mad_fixed_t target[2][32];		/* requested gains [ch][sb] */
+  mad_fixed_t delta[2][32];		/* change per subband sample */
+  struct mad_gain_block current;	/* gains now applied */
+
+  unsigned int ramp;			/* subband samples left to ramp */
+  int unity;				/* all gains are exactly 1 */
+};
+
+void mad_gain_init(struct mad_gain *);
+
+# define mad_gain_finish(gain)  /* nothing */
+
+void mad_gain_set(struct mad_gain *, mad_fixed_t const [2][32],
+		  unsigned int);
+
+struct mad_gain_block const *mad_gain_step(struct mad_gain *, unsigned int);
+
+/*
+ * Gained products saturate at +/- MAD_GAIN_CEIL rather than wrapping. The
+ * range is symmetric, so that a saturated sample can still be negated, and
+ * slightly inside that of mad_fixed_t, so that no mad_f_mul() rounding can
+ * carry a product past it.
+ */
+# define MAD_GAIN_CEIL		(MAD_F_MAX - MAD_F_MAX / 4096)
+
+/* product of a sample and a gain, saturated using the gain's limit */
+# define mad_gain_mul(x, gain, limit)  \
+    ((x) >  (limit) ?  MAD_GAIN_CEIL :  \
+     (x) < -(limit) ? -MAD_GAIN_CEIL : mad_f_mul((x), (gain)))
 
 # endif
 
@@ -951,10 +1164,42 @@ enum mad_flow {
   MAD_FLOW_IGNORE   = 0x0020	/* ignore the current frame */
 };
 
+enum mad_stage {
+  MAD_STAGE_HEADER = 0,		/* frame header */
+  MAD_STAGE_CRC,		/* CRC check */
+  MAD_STAGE_SIDEINFO,		/* side info, bit allocation, bit reservoir */
+  MAD_STAGE_SCALEFACTORS,	/* scalefactors */
+  MAD_STAGE_HUFFMAN,		/* Layer III Huffman decoding, requantization */
+  MAD_STAGE_REQUANTIZE,		/* Layer I/II sample requantization */
+  MAD_STAGE_STEREO,		/* Layer III joint stereo */
+  MAD_STAGE_ALIAS,		/* Layer III reordering, alias reduction */
+  MAD_STAGE_IMDCT,		/* Layer III IMDCT, overlap-add, inversion */
+  MAD_STAGE_SYNTH,		/* synthesis matrixing and windowing */
+  MAD_STAGE_OUTPUT,		/* output callback */
+
+  MAD_NSTAGES
+};
+
+# if defined(_MSC_VER)
+typedef unsigned __int64 mad_nsec_t;
+# elif defined(__GNUC__) ||  \
+      (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L)
+typedef unsigned long long mad_nsec_t;
+# else
+typedef unsigned long mad_nsec_t;
+# endif
+
+struct mad_stats {
+  unsigned long frames;			/* frames synthesized */
+  mad_nsec_t nsec[MAD_NSTAGES];		/* time spent in each stage */
+};
+
 struct mad_decoder {
   enum mad_decoder_mode mode;
 
   int options;
+  struct mad_allocator const *allocator;
+  struct mad_gain *gain;		/* subband gains, if any */
 
   struct {
     long pid;
@@ -966,8 +1211,16 @@ struct mad_decoder {
     struct mad_stream stream;
     struct mad_frame frame;
     struct mad_synth synth;
+    mad_timer_t timer;
   } *sync;
 
+  struct {
+    void const *data;
+    unsigned int length;
+  } restore;
+
+  struct mad_stats stats;		/* stage timing (with OPT_STATS) */
+
   void *cb_data;
 
   enum mad_flow (*input_func)(void *, struct mad_stream *);
@@ -978,6 +1231,9 @@ struct mad_decoder {
 			       struct mad_header const *, struct mad_pcm *);
   enum mad_flow (*error_func)(void *, struct mad_stream *, struct mad_frame *);
   enum mad_flow (*message_func)(void *, void *, unsigned int *);
+
+  enum mad_flow (*bands_func)(void *, struct mad_header const *,
+			      struct mad_bands const *);
 };
 
 void mad_decoder_init(struct mad_decoder *, void *,
@@ -998,9 +1254,26 @@ int mad_decoder_finish(struct mad_decoder *);
 # define mad_decoder_options(decoder, opts)  \
     ((void) ((decoder)->options = (opts)))
 
+# define mad_decoder_allocator(decoder, alloc)  \
+    ((void) ((decoder)->allocator = (alloc)))
+
+# define mad_decoder_gain(decoder, g)  \
+    ((void) ((decoder)->gain = (g)))
+
+/* with a bands callback, frames are analyzed instead of synthesized */
+# define mad_decoder_bands(decoder, func)  \
+    ((void) ((decoder)->bands_func = (func)))
+
 int mad_decoder_run(struct mad_decoder *, enum mad_decoder_mode);
 int mad_decoder_message(struct mad_decoder *, void *, unsigned int *);
 
+int mad_decoder_snapshot(struct mad_decoder *, void *, unsigned int *);
+int mad_decoder_restore(struct mad_decoder *, void const *, unsigned int);
+
+int mad_decoder_batch(struct mad_decoder *, unsigned int, unsigned int, int *);
+
+int mad_decoder_stats(struct mad_decoder const *, struct mad_stats *);
+
 # endif
 
 #ifdef __cplusplus
@@ -0,0 +1,227 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * $Id$
+ */
+
+# ifdef HAVE_CONFIG_H
+#  include "config.h"
+# endif
+
+# include "global.h"
+
+# include <stdlib.h>
+
+# if defined(USE_THREADS)
+#  include <pthread.h>
+# endif
+
+# include "pool.h"
+
+/*
+ * A pool is a fixed set of worker threads servicing a FIFO of jobs. Job
+ * storage is owned by the caller, so queueing never allocates; each job is
+ * told the index of the worker running it so callers can keep per-worker
+ * scratch state. Without thread support (or with a null pool) jobs simply
+ * run to completion inside mad_pool_submit() as worker 0.
+ */
+
+# if defined(USE_THREADS)
+struct worker {
+  struct mad_pool *pool;
+  unsigned int index;
+  pthread_t thread;
+};
+
+struct mad_pool {
+  pthread_mutex_t lock;
+  pthread_cond_t ready;			/* jobs queued or shutting down */
+  pthread_cond_t idle;			/* all jobs have completed */
+
+  struct mad_job *head;
+  struct mad_job **tail;
+  unsigned int pending;			/* jobs queued or running */
+  int quit;
+
+  unsigned int nworkers;
+  struct worker *workers;
+};
+
+static
+void *work(void *data)
+{
+  struct worker *self = data;
+  struct mad_pool *pool = self->pool;
+  struct mad_job *job;
+
+  pthread_mutex_lock(&pool->lock);
+
+  while (1) {
+    while (pool->head == 0 && !pool->quit)
+      pthread_cond_wait(&pool->ready, &pool->lock);
+
+    job = pool->head;
+    if (job == 0)
+      break;
+
+    pool->head = job->next;
+    if (pool->head == 0)
+      pool->tail = &pool->head;
+
+    pthread_mutex_unlock(&pool->lock);
+    job->func(job->data, self->index);
+    pthread_mutex_lock(&pool->lock);
+
+    if (--pool->pending == 0)
+      pthread_cond_broadcast(&pool->idle);
+  }
+
+  pthread_mutex_unlock(&pool->lock);
+
+  return 0;
+}
+# endif
+
+/*
+ * NAME:	pool->create()
+ * DESCRIPTION:	start a pool of worker threads, or return 0 if none
+ */
+struct mad_pool *mad_pool_create(unsigned int nworkers)
+{
+# if defined(USE_THREADS)
+  struct mad_pool *pool;
+  unsigned int i;
+
+  if (nworkers == 0)
+    return 0;
+
+  pool = malloc(sizeof(*pool));
+  if (pool == 0)
+    return 0;
+
+  pool->workers = malloc(nworkers * sizeof(*pool->workers));
+  if (pool->workers == 0) {
+    free(pool);
+    return 0;
+  }
+
+  pthread_mutex_init(&pool->lock, 0);
+  pthread_cond_init(&pool->ready, 0);
+  pthread_cond_init(&pool->idle, 0);
+
+  pool->head     = 0;
+  pool->tail     = &pool->head;
+  pool->pending  = 0;
+  pool->quit     = 0;
+  pool->nworkers = 0;
+
+  for (i = 0; i < nworkers; ++i) {
+    pool->workers[i].pool  = pool;
+    pool->workers[i].index = i;
+
+    if (pthread_create(&pool->workers[i].thread, 0,
+		       work, &pool->workers[i]) != 0)
+      break;
+
+    ++pool->nworkers;
+  }
+
+  if (pool->nworkers < nworkers) {
+    mad_pool_destroy(pool);
+    return 0;
+  }
+
+  return pool;
+# else
+  return 0;
+# endif
+}
+
+/*
+ * NAME:	pool->destroy()
+ * DESCRIPTION:	wait for outstanding jobs and stop all worker threads
+ */
+void mad_pool_destroy(struct mad_pool *pool)
+{
+# if defined(USE_THREADS)
+  unsigned int i;
+
+  if (pool == 0)
+    return;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->quit = 1;
+  pthread_cond_broadcast(&pool->ready);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (i = 0; i < pool->nworkers; ++i)
+    pthread_join(pool->workers[i].thread, 0);
+
+  pthread_cond_destroy(&pool->idle);
+  pthread_cond_destroy(&pool->ready);
+  pthread_mutex_destroy(&pool->lock);
+
+  free(pool->workers);
+  free(pool);
+# endif
+}
+
+/*
+ * NAME:	pool->submit()
+ * DESCRIPTION:	queue a job for execution by the next free worker
+ */
+void mad_pool_submit(struct mad_pool *pool, struct mad_job *job)
+{
+# if defined(USE_THREADS)
+  if (pool) {
+    job->next = 0;
+
+    pthread_mutex_lock(&pool->lock);
+
+    *pool->tail = job;
+    pool->tail  = &job->next;
+    ++pool->pending;
+
+    pthread_cond_signal(&pool->ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    return;
+  }
+# endif
+
+  job->func(job->data, 0);
+}
+
+/*
+ * NAME:	pool->wait()
+ * DESCRIPTION:	block until every submitted job has completed
+ */
+void mad_pool_wait(struct mad_pool *pool)
+{
+# if defined(USE_THREADS)
+  if (pool == 0)
+    return;
+
+  pthread_mutex_lock(&pool->lock);
+
+  while (pool->pending)
+    pthread_cond_wait(&pool->idle, &pool->lock);
+
+  pthread_mutex_unlock(&pool->lock);
+# endif
+}
@@ -0,0 +1,39 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * $Id$
+ */
+
+# ifndef LIBMAD_POOL_H
+# define LIBMAD_POOL_H
+
+struct mad_job {
+  void (*func)(void *, unsigned int);	/* job routine (data, worker) */
+  void *data;				/* job routine argument */
+  struct mad_job *next;			/* queue link (private) */
+};
+
+struct mad_pool;
+
+struct mad_pool *mad_pool_create(unsigned int);
+void mad_pool_destroy(struct mad_pool *);
+
+void mad_pool_submit(struct mad_pool *, struct mad_job *);
+void mad_pool_wait(struct mad_pool *);
+
+# endif
@@ -0,0 +1,183 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * $Id$
+ */
+
+# ifdef HAVE_CONFIG_H
+#  include "config.h"
+# endif
+
+# include "global.h"
+
+# include <stdlib.h>
+# include <string.h>
+
+# include "fixed.h"
+# include "stream.h"
+# include "frame.h"
+# include "synth.h"
+# include "state.h"
+# include "alloc.h"
+
+/*
+ * A state holds only what must survive from one frame to the next: the
+ * bitstream and bit reservoir, the Layer III overlap buffer and the
+ * synthesis filterbank history. The working buffers (subband samples,
+ * PCM output and the Layer III spectrum, which lives on the stack) belong
+ * to a scratch frame and synth that any number of states may share, one
+ * at a time, e.g. one pair per decoding thread.
+ */
+
+/*
+ * NAME:	state->init()
+ * DESCRIPTION:	initialize persistent per-stream decoding state
+ */
+void mad_state_init(struct mad_state *state)
+{
+  mad_stream_init(&state->stream);
+
+  state->overlap = 0;
+  state->filter  = 0;
+  state->phase   = 0;
+}
+
+/*
+ * NAME:	state->finish()
+ * DESCRIPTION:	deallocate any dynamic memory associated with state
+ */
+void mad_state_finish(struct mad_state *state)
+{
+  unsigned char *block = (unsigned char *) state->filter;
+
+  if (block) {
+    if ((unsigned char *) state->overlap == block + sizeof(*state->filter))
+      state->overlap = 0;
+
+    if ((unsigned char *) state->stream.main_data ==
+	block + sizeof(*state->filter) + sizeof(*state->overlap))
+      state->stream.main_data = 0;
+
+    state->filter = 0;
+  }
+
+  if (state->overlap) {
+    mad_free(state->overlap);
+    state->overlap = 0;
+  }
+
+  mad_stream_finish(&state->stream);
+
+  mad_free(block);
+}
+
+/*
+ * NAME:	state_alloc()
+ * DESCRIPTION:	carve the persistent buffers from one contiguous block
+ */
+static
+int state_alloc(struct mad_state *state)
+{
+  unsigned char *block;
+
+  /* each part is a multiple of the cache line size, so all stay aligned */
+
+  block = mad_alloc(state->stream.allocator,
+		    sizeof(*state->filter) + sizeof(*state->overlap) +
+		    MAD_BUFFER_MDLEN);
+  if (block == 0)
+    return -1;
+
+  memset(block, 0, sizeof(*state->filter) + sizeof(*state->overlap));
+
+  state->filter = (void *) block;
+  block += sizeof(*state->filter);
+
+  if (state->overlap == 0)
+    state->overlap = (void *) block;
+  block += sizeof(*state->overlap);
+
+  if (state->stream.main_data == 0)
+    state->stream.main_data = (void *) block;
+
+  return 0;
+}
+
+/*
+ * NAME:	state->attach()
+ * DESCRIPTION:	lend persistent state to a scratch frame and synth
+ */
+int mad_state_attach(struct mad_state *state, struct mad_frame *frame,
+		     struct mad_synth *synth)
+{
+  mad_fixed_t (*overlap)[2][32][18];
+
+  if (state->filter == 0 && state_alloc(state) == -1) {
+    state->stream.error = MAD_ERROR_NOMEM;
+    return -1;
+  }
+
+  /* the frame's own overlap buffer (if any) is parked in the state */
+
+  overlap        = frame->overlap;
+  frame->overlap = state->overlap;
+  state->overlap = overlap;
+
+  memcpy(synth->filter, *state->filter, sizeof(synth->filter));
+  synth->phase = state->phase;
+
+  return 0;
+}
+
+/*
+ * NAME:	state->detach()
+ * DESCRIPTION:	take persistent state back from a scratch frame and synth
+ */
+void mad_state_detach(struct mad_state *state, struct mad_frame *frame,
+		      struct mad_synth *synth)
+{
+  mad_fixed_t (*overlap)[2][32][18];
+
+  overlap        = frame->overlap;
+  frame->overlap = state->overlap;
+  state->overlap = overlap;
+
+  memcpy(*state->filter, synth->filter, sizeof(synth->filter));
+  state->phase = synth->phase;
+}
+
+/*
+ * NAME:	state->decode()
+ * DESCRIPTION:	decode and synthesize one frame using scratch buffers
+ */
+int mad_state_decode(struct mad_state *state, struct mad_frame *frame,
+		     struct mad_synth *synth)
+{
+  int result;
+
+  if (mad_state_attach(state, frame, synth) == -1)
+    return -1;
+
+  result = mad_frame_decode(frame, &state->stream);
+  if (result == 0)
+    mad_synth_frame(synth, frame);
+
+  mad_state_detach(state, frame, synth);
+
+  return result;
+}
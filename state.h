@@ -0,0 +1,50 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * $Id$
+ */
+
+# ifndef LIBMAD_STATE_H
+# define LIBMAD_STATE_H
+
+# include "fixed.h"
+# include "stream.h"
+# include "frame.h"
+# include "synth.h"
+
+struct mad_state {
+  struct mad_stream stream;		/* bitstream and Layer III reservoir */
+
+  mad_fixed_t (*overlap)[2][32][18];	/* Layer III block overlap data */
+  mad_fixed_t (*filter)[2][2][2][16][8];
+					/* polyphase filterbank outputs */
+  unsigned int phase;			/* synthesis processing phase */
+};
+
+void mad_state_init(struct mad_state *);
+void mad_state_finish(struct mad_state *);
+
+int mad_state_attach(struct mad_state *, struct mad_frame *,
+		     struct mad_synth *);
+void mad_state_detach(struct mad_state *, struct mad_frame *,
+		      struct mad_synth *);
+
+int mad_state_decode(struct mad_state *, struct mad_frame *,
+		     struct mad_synth *);
+
+# endif
@@ -0,0 +1,94 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * $Id$
+ */
+
+
+# ifdef HAVE_CONFIG_H
+#  include "config.h"
+# endif
+
+# include "global.h"
+
+# if defined(OPT_STATS)
+#  include <time.h>
+# endif
+
+# include "stats.h"
+
+# if defined(OPT_STATS)
+/*
+ * NAME:	clock_nsec()
+ * DESCRIPTION:	return a monotonic clock reading in nanoseconds
+ */
+static
+mad_nsec_t clock_nsec(void)
+{
+#  if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (mad_nsec_t) now.tv_sec * 1000000000L + now.tv_nsec;
+#  else
+  return (mad_nsec_t) clock() * (1000000000L / CLOCKS_PER_SEC);
+#  endif
+}
+
+/*
+ * NAME:	lap->start()
+ * DESCRIPTION:	begin timing stages, charging them to the given stats
+ */
+void mad_lap_start(struct mad_lap *lap, struct mad_stats *stats)
+{
+  lap->stats = stats;
+  lap->mark  = stats ? clock_nsec() : 0;
+}
+
+/*
+ * NAME:	lap()
+ * DESCRIPTION:	charge the time since the previous lap to a stage
+ */
+void mad_lap(struct mad_lap *lap, enum mad_stage stage)
+{
+  mad_nsec_t now;
+
+  if (lap->stats == 0)
+    return;
+
+  now = clock_nsec();
+
+  lap->stats->nsec[stage] += now - lap->mark;
+  lap->mark = now;
+}
+
+/*
+ * NAME:	stats->merge()
+ * DESCRIPTION:	add one set of stage times to another and clear it
+ */
+void mad_stats_merge(struct mad_stats *stats, struct mad_stats *other)
+{
+  unsigned int stage;
+
+  for (stage = 0; stage < MAD_NSTAGES; ++stage) {
+    stats->nsec[stage] += other->nsec[stage];
+    other->nsec[stage]  = 0;
+  }
+}
+# endif
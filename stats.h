@@ -0,0 +1,54 @@
+/*
+ * libmad - MPEG audio decoder library
+ * Copyright (C) 2000-2004 Underbit Technologies, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * $Id$
+ */
+
+
+# ifndef LIBMAD_STATS_H
+# define LIBMAD_STATS_H
+
+# include "decoder.h"
+
+/*
+ * Stage timing is taken as laps: each lap charges the time since the
+ * previous one to the named stage, so consecutive stages cost one clock
+ * read apiece. A lap started with a null stats pointer records nothing.
+ */
+
+struct mad_lap {
+  struct mad_stats *stats;		/* where laps are charged (0 = none) */
+  mad_nsec_t mark;			/* clock at the previous lap */
+};
+
+# if defined(OPT_STATS)
+void mad_lap_start(struct mad_lap *, struct mad_stats *);
+void mad_lap(struct mad_lap *, enum mad_stage);
+
+void mad_stats_merge(struct mad_stats *, struct mad_stats *);
+
+#  define STATS_LAP_DECL(lap)		struct mad_lap lap;
+#  define STATS_LAP_START(lap, stats)	mad_lap_start(&(lap), (stats))
+#  define STATS_LAP(lap, stage)		mad_lap(&(lap), (stage))
+# else
+#  define STATS_LAP_DECL(lap)		/* nothing */
+#  define STATS_LAP_START(lap, stats)	((void) (stats))
+#  define STATS_LAP(lap, stage)		((void) 0)
+# endif
+
+# endif
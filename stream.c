@@ -26,9 +26,11 @@
 # include "global.h"
 
 # include <stdlib.h>
+# include <string.h>
 
 # include "bit.h"
 # include "stream.h"
+# include "alloc.h"
 
 /*
  * NAME:	stream->init()
@@ -42,6 +44,7 @@ void mad_stream_init(struct mad_stream *stream)
 
   stream->sync       = 0;
   stream->freerate   = 0;
+  stream->samples    = 0;
 
   stream->this_frame = 0;
   stream->next_frame = 0;
@@ -52,6 +55,8 @@ void mad_stream_init(struct mad_stream *stream)
 
   stream->main_data  = 0;
   stream->md_len     = 0;
+  stream->allocator  = 0;
+  stream->stats      = 0;
 
   stream->options    = 0;
   stream->error      = MAD_ERROR_NONE;
@@ -64,7 +69,7 @@ void mad_stream_init(struct mad_stream *stream)
 void mad_stream_finish(struct mad_stream *stream)
 {
   if (stream->main_data) {
-    free(stream->main_data);
+    mad_free(stream->main_data);
     stream->main_data = 0;
   }
 
@@ -110,9 +115,16 @@ int mad_stream_sync(struct mad_stream *stream)
   ptr = mad_bit_nextbyte(&stream->ptr);
   end = stream->bufend;
 
+  /* memchr() skips the bytes that cannot begin a sync word in bulk */
+
   while (ptr < end - 1 &&
-	 !(ptr[0] == 0xff && (ptr[1] & 0xe0) == 0xe0))
-    ++ptr;
+	 !(ptr[0] == 0xff && (ptr[1] & 0xe0) == 0xe0)) {
+    ptr = memchr(ptr + 1, 0xff, end - 1 - (ptr + 1));
+    if (ptr == 0) {
+      ptr = end - 1;
+      break;
+    }
+  }
 
   if (end - ptr < MAD_BUFFER_GUARD)
     return -1;
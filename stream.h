@@ -23,6 +23,7 @@
 # define LIBMAD_STREAM_H
 
 # include "bit.h"
+# include "timer.h"
 
 # define MAD_BUFFER_GUARD	8
 # define MAD_BUFFER_MDLEN	(511 + 2048 + MAD_BUFFER_GUARD)
@@ -58,6 +59,14 @@ enum mad_error {
 
 # define MAD_RECOVERABLE(error)	((error) & 0xff00)
 
+struct mad_allocator {
+  void *(*alloc)(void *, unsigned long);	/* allocate (data, size) */
+  void (*free)(void *, void *);		/* release (data, pointer) */
+  void *data;				/* allocator context */
+};
+
+struct mad_stats;
+
 struct mad_stream {
   unsigned char const *buffer;		/* input bitstream buffer */
   unsigned char const *bufend;		/* end of buffer */
@@ -65,6 +74,7 @@ struct mad_stream {
 
   int sync;				/* stream sync found */
   unsigned long freerate;		/* free bitrate (fixed) */
+  mad_samples_t samples;		/* PCM samples in decoded headers */
 
   unsigned char const *this_frame;	/* start of current frame */
   unsigned char const *next_frame;	/* start of next frame */
@@ -76,6 +86,8 @@ struct mad_stream {
   unsigned char (*main_data)[MAD_BUFFER_MDLEN];
 					/* Layer III main_data() */
   unsigned int md_len;			/* bytes in main_data */
+  struct mad_allocator const *allocator;/* dynamic buffers (0 = default) */
+  struct mad_stats *stats;		/* stage timing (0 = none) */
 
   int options;				/* decoding options (see below) */
   enum mad_error error;			/* error code (see above) */
@@ -83,7 +95,9 @@ struct mad_stream {
 
 enum {
   MAD_OPTION_IGNORECRC      = 0x0001,	/* ignore CRC errors */
-  MAD_OPTION_HALFSAMPLERATE = 0x0002	/* generate PCM at 1/2 sample rate */
+  MAD_OPTION_HALFSAMPLERATE = 0x0002,	/* generate PCM at 1/2 sample rate */
+  MAD_OPTION_THREADED       = 0x0004,	/* use a worker thread for Layer III */
+  MAD_OPTION_GRANULES       = 0x0008	/* output Layer III PCM per granule */
 # if 0  /* not yet implemented */
   MAD_OPTION_LEFTCHANNEL    = 0x0010,	/* decode left channel only */
   MAD_OPTION_RIGHTCHANNEL   = 0x0020,	/* decode right channel only */
@@ -91,6 +105,15 @@ enum {
 # endif
 };
 
+/*
+ * With MAD_OPTION_GRANULES, mad_decoder_run() calls the output callback once
+ * per Layer III granule with 576 samples per channel (288 at half sample
+ * rate) instead of once per frame, and calls the filter callback once per
+ * frame before its first granule, when only sbsample[ch][0..17] are valid.
+ */
+
+void mad_allocator_set(struct mad_allocator const *);
+
 void mad_stream_init(struct mad_stream *);
 void mad_stream_finish(struct mad_stream *);
 
@@ -28,6 +28,7 @@
 # include "fixed.h"
 # include "frame.h"
 # include "synth.h"
+# include "stats.h"
 
 /*
  * NAME:	synth->init()
@@ -42,6 +43,8 @@ void mad_synth_init(struct mad_synth *synth)
   synth->pcm.samplerate = 0;
   synth->pcm.channels   = 0;
   synth->pcm.length     = 0;
+
+  synth->stats = 0;
 }
 
 /*
@@ -115,39 +118,7 @@ void mad_synth_mute(struct mad_synth *synth)
 #  define MUL(x, y)  mad_f_mul((x), (y))
 # endif
 
-/*
- * NAME:	dct32()
- * DESCRIPTION:	perform fast in[32]->out[32] DCT
- */
-static
-void dct32(mad_fixed_t const in[32], unsigned int slot,
-	   mad_fixed_t lo[16][8], mad_fixed_t hi[16][8])
-{
-  mad_fixed_t t0,   t1,   t2,   t3,   t4,   t5,   t6,   t7;
-  mad_fixed_t t8,   t9,   t10,  t11,  t12,  t13,  t14,  t15;
-  mad_fixed_t t16,  t17,  t18,  t19,  t20,  t21,  t22,  t23;
-  mad_fixed_t t24,  t25,  t26,  t27,  t28,  t29,  t30,  t31;
-  mad_fixed_t t32,  t33,  t34,  t35,  t36,  t37,  t38,  t39;
-  mad_fixed_t t40,  t41,  t42,  t43,  t44,  t45,  t46,  t47;
-  mad_fixed_t t48,  t49,  t50,  t51,  t52,  t53,  t54,  t55;
-  mad_fixed_t t56,  t57,  t58,  t59,  t60,  t61,  t62,  t63;
-  mad_fixed_t t64,  t65,  t66,  t67,  t68,  t69,  t70,  t71;
-  mad_fixed_t t72,  t73,  t74,  t75,  t76,  t77,  t78,  t79;
-  mad_fixed_t t80,  t81,  t82,  t83,  t84,  t85,  t86,  t87;
-  mad_fixed_t t88,  t89,  t90,  t91,  t92,  t93,  t94,  t95;
-  mad_fixed_t t96,  t97,  t98,  t99,  t100, t101, t102, t103;
-  mad_fixed_t t104, t105, t106, t107, t108, t109, t110, t111;
-  mad_fixed_t t112, t113, t114, t115, t116, t117, t118, t119;
-  mad_fixed_t t120, t121, t122, t123, t124, t125, t126, t127;
-  mad_fixed_t t128, t129, t130, t131, t132, t133, t134, t135;
-  mad_fixed_t t136, t137, t138, t139, t140, t141, t142, t143;
-  mad_fixed_t t144, t145, t146, t147, t148, t149, t150, t151;
-  mad_fixed_t t152, t153, t154, t155, t156, t157, t158, t159;
-  mad_fixed_t t160, t161, t162, t163, t164, t165, t166, t167;
-  mad_fixed_t t168, t169, t170, t171, t172, t173, t174, t175;
-  mad_fixed_t t176;
-
-  /* costab[i] = cos(PI / (2 * 32) * i) */
+/* costab[i] = cos(PI / (2 * 32) * i) */
 
 # if defined(OPT_DCTO)
 #  define costab1	MAD_F(0x7fd8878e)
@@ -215,305 +186,135 @@ void dct32(mad_fixed_t const in[32], unsigned int slot,
 #  define costab31	MAD_F(0x00c8fb30)  /* 0.049067674 */
 # endif
 
-  t0   = in[0]  + in[31];  t16  = MUL(in[0]  - in[31], costab1);
-  t1   = in[15] + in[16];  t17  = MUL(in[15] - in[16], costab31);
-
-  t41  = t16 + t17;
-  t59  = MUL(t16 - t17, costab2);
-  t33  = t0  + t1;
-  t50  = MUL(t0  - t1,  costab2);
-
-  t2   = in[7]  + in[24];  t18  = MUL(in[7]  - in[24], costab15);
-  t3   = in[8]  + in[23];  t19  = MUL(in[8]  - in[23], costab17);
-
-  t42  = t18 + t19;
-  t60  = MUL(t18 - t19, costab30);
-  t34  = t2  + t3;
-  t51  = MUL(t2  - t3,  costab30);
-
-  t4   = in[3]  + in[28];  t20  = MUL(in[3]  - in[28], costab7);
-  t5   = in[12] + in[19];  t21  = MUL(in[12] - in[19], costab25);
-
-  t43  = t20 + t21;
-  t61  = MUL(t20 - t21, costab14);
-  t35  = t4  + t5;
-  t52  = MUL(t4  - t5,  costab14);
-
-  t6   = in[4]  + in[27];  t22  = MUL(in[4]  - in[27], costab9);
-  t7   = in[11] + in[20];  t23  = MUL(in[11] - in[20], costab23);
-
-  t44  = t22 + t23;
-  t62  = MUL(t22 - t23, costab18);
-  t36  = t6  + t7;
-  t53  = MUL(t6  - t7,  costab18);
-
-  t8   = in[1]  + in[30];  t24  = MUL(in[1]  - in[30], costab3);
-  t9   = in[14] + in[17];  t25  = MUL(in[14] - in[17], costab29);
-
-  t45  = t24 + t25;
-  t63  = MUL(t24 - t25, costab6);
-  t37  = t8  + t9;
-  t54  = MUL(t8  - t9,  costab6);
-
-  t10  = in[6]  + in[25];  t26  = MUL(in[6]  - in[25], costab13);
-  t11  = in[9]  + in[22];  t27  = MUL(in[9]  - in[22], costab19);
-
-  t46  = t26 + t27;
-  t64  = MUL(t26 - t27, costab26);
-  t38  = t10 + t11;
-  t55  = MUL(t10 - t11, costab26);
-
-  t12  = in[2]  + in[29];  t28  = MUL(in[2]  - in[29], costab5);
-  t13  = in[13] + in[18];  t29  = MUL(in[13] - in[18], costab27);
-
-  t47  = t28 + t29;
-  t65  = MUL(t28 - t29, costab10);
-  t39  = t12 + t13;
-  t56  = MUL(t12 - t13, costab10);
-
-  t14  = in[5]  + in[26];  t30  = MUL(in[5]  - in[26], costab11);
-  t15  = in[10] + in[21];  t31  = MUL(in[10] - in[21], costab21);
-
-  t48  = t30 + t31;
-  t66  = MUL(t30 - t31, costab22);
-  t40  = t14 + t15;
-  t57  = MUL(t14 - t15, costab22);
-
-  t69  = t33 + t34;  t89  = MUL(t33 - t34, costab4);
-  t70  = t35 + t36;  t90  = MUL(t35 - t36, costab28);
-  t71  = t37 + t38;  t91  = MUL(t37 - t38, costab12);
-  t72  = t39 + t40;  t92  = MUL(t39 - t40, costab20);
-  t73  = t41 + t42;  t94  = MUL(t41 - t42, costab4);
-  t74  = t43 + t44;  t95  = MUL(t43 - t44, costab28);
-  t75  = t45 + t46;  t96  = MUL(t45 - t46, costab12);
-  t76  = t47 + t48;  t97  = MUL(t47 - t48, costab20);
-
-  t78  = t50 + t51;  t100 = MUL(t50 - t51, costab4);
-  t79  = t52 + t53;  t101 = MUL(t52 - t53, costab28);
-  t80  = t54 + t55;  t102 = MUL(t54 - t55, costab12);
-  t81  = t56 + t57;  t103 = MUL(t56 - t57, costab20);
-
-  t83  = t59 + t60;  t106 = MUL(t59 - t60, costab4);
-  t84  = t61 + t62;  t107 = MUL(t61 - t62, costab28);
-  t85  = t63 + t64;  t108 = MUL(t63 - t64, costab12);
-  t86  = t65 + t66;  t109 = MUL(t65 - t66, costab20);
-
-  t113 = t69  + t70;
-  t114 = t71  + t72;
-
-  /*  0 */ hi[15][slot] = SHIFT(t113 + t114);
-  /* 16 */ lo[ 0][slot] = SHIFT(MUL(t113 - t114, costab16));
-
-  t115 = t73  + t74;
-  t116 = t75  + t76;
-
-  t32  = t115 + t116;
-
-  /*  1 */ hi[14][slot] = SHIFT(t32);
-
-  t118 = t78  + t79;
-  t119 = t80  + t81;
-
-  t58  = t118 + t119;
-
-  /*  2 */ hi[13][slot] = SHIFT(t58);
-
-  t121 = t83  + t84;
-  t122 = t85  + t86;
-
-  t67  = t121 + t122;
-
-  t49  = (t67 * 2) - t32;
-
-  /*  3 */ hi[12][slot] = SHIFT(t49);
-
-  t125 = t89  + t90;
-  t126 = t91  + t92;
-
-  t93  = t125 + t126;
-
-  /*  4 */ hi[11][slot] = SHIFT(t93);
-
-  t128 = t94  + t95;
-  t129 = t96  + t97;
-
-  t98  = t128 + t129;
-
-  t68  = (t98 * 2) - t49;
-
-  /*  5 */ hi[10][slot] = SHIFT(t68);
-
-  t132 = t100 + t101;
-  t133 = t102 + t103;
-
-  t104 = t132 + t133;
-
-  t82  = (t104 * 2) - t58;
-
-  /*  6 */ hi[ 9][slot] = SHIFT(t82);
-
-  t136 = t106 + t107;
-  t137 = t108 + t109;
-
-  t110 = t136 + t137;
-
-  t87  = (t110 * 2) - t67;
-
-  t77  = (t87 * 2) - t68;
-
-  /*  7 */ hi[ 8][slot] = SHIFT(t77);
-
-  t141 = MUL(t69 - t70, costab8);
-  t142 = MUL(t71 - t72, costab24);
-  t143 = t141 + t142;
-
-  /*  8 */ hi[ 7][slot] = SHIFT(t143);
-  /* 24 */ lo[ 8][slot] =
-	     SHIFT((MUL(t141 - t142, costab16) * 2) - t143);
-
-  t144 = MUL(t73 - t74, costab8);
-  t145 = MUL(t75 - t76, costab24);
-  t146 = t144 + t145;
-
-  t88  = (t146 * 2) - t77;
-
-  /*  9 */ hi[ 6][slot] = SHIFT(t88);
-
-  t148 = MUL(t78 - t79, costab8);
-  t149 = MUL(t80 - t81, costab24);
-  t150 = t148 + t149;
-
-  t105 = (t150 * 2) - t82;
-
-  /* 10 */ hi[ 5][slot] = SHIFT(t105);
-
-  t152 = MUL(t83 - t84, costab8);
-  t153 = MUL(t85 - t86, costab24);
-  t154 = t152 + t153;
-
-  t111 = (t154 * 2) - t87;
-
-  t99  = (t111 * 2) - t88;
-
-  /* 11 */ hi[ 4][slot] = SHIFT(t99);
-
-  t157 = MUL(t89 - t90, costab8);
-  t158 = MUL(t91 - t92, costab24);
-  t159 = t157 + t158;
-
-  t127 = (t159 * 2) - t93;
-
-  /* 12 */ hi[ 3][slot] = SHIFT(t127);
-
-  t160 = (MUL(t125 - t126, costab16) * 2) - t127;
-
-  /* 20 */ lo[ 4][slot] = SHIFT(t160);
-  /* 28 */ lo[12][slot] =
-	     SHIFT((((MUL(t157 - t158, costab16) * 2) - t159) * 2) - t160);
-
-  t161 = MUL(t94 - t95, costab8);
-  t162 = MUL(t96 - t97, costab24);
-  t163 = t161 + t162;
-
-  t130 = (t163 * 2) - t98;
-
-  t112 = (t130 * 2) - t99;
-
-  /* 13 */ hi[ 2][slot] = SHIFT(t112);
-
-  t164 = (MUL(t128 - t129, costab16) * 2) - t130;
-
-  t166 = MUL(t100 - t101, costab8);
-  t167 = MUL(t102 - t103, costab24);
-  t168 = t166 + t167;
-
-  t134 = (t168 * 2) - t104;
-
-  t120 = (t134 * 2) - t105;
-
-  /* 14 */ hi[ 1][slot] = SHIFT(t120);
-
-  t135 = (MUL(t118 - t119, costab16) * 2) - t120;
-
-  /* 18 */ lo[ 2][slot] = SHIFT(t135);
-
-  t169 = (MUL(t132 - t133, costab16) * 2) - t134;
-
-  t151 = (t169 * 2) - t135;
-
-  /* 22 */ lo[ 6][slot] = SHIFT(t151);
-
-  t170 = (((MUL(t148 - t149, costab16) * 2) - t150) * 2) - t151;
-
-  /* 26 */ lo[10][slot] = SHIFT(t170);
-  /* 30 */ lo[14][slot] =
-	     SHIFT((((((MUL(t166 - t167, costab16) * 2) -
-		       t168) * 2) - t169) * 2) - t170);
-
-  t171 = MUL(t106 - t107, costab8);
-  t172 = MUL(t108 - t109, costab24);
-  t173 = t171 + t172;
-
-  t138 = (t173 * 2) - t110;
-
-  t123 = (t138 * 2) - t111;
-
-  t139 = (MUL(t121 - t122, costab16) * 2) - t123;
-
-  t117 = (t123 * 2) - t112;
+/*
+ * NAME:	dct32()
+ * DESCRIPTION:	perform fast in[32]->out[32] DCT
+ */
+static
+void dct32(mad_fixed_t const in[32], unsigned int slot,
+	   mad_fixed_t lo[16][8], mad_fixed_t hi[16][8])
+{
+# define IN(i)	(in[i])
+# define LO(i)	(lo[i][slot])
+# define HI(i)	(hi[i][slot])
 
-  /* 15 */ hi[ 0][slot] = SHIFT(t117);
+# include "dct32.dat"
 
-  t124 = (MUL(t115 - t116, costab16) * 2) - t117;
+# undef IN
+# undef LO
+# undef HI
+}
 
-  /* 17 */ lo[ 1][slot] = SHIFT(t124);
+/*
+ * Synthesis of 1 in 2 samples reads only the even rows of lo[] and the odd
+ * rows of hi[], and synthesis of 1 in 4 (or fewer) only every fourth. The
+ * following versions of dct32() store just those outputs; the others go to
+ * a local the compiler can discard, together with their computation.
+ */
 
-  t131 = (t139 * 2) - t124;
+/*
+ * NAME:	dct32_half()
+ * DESCRIPTION:	perform dct32() for synthesis of 1 in 2 samples
+ */
+static
+void dct32_half(mad_fixed_t const in[32], unsigned int slot,
+		mad_fixed_t lo[16][8], mad_fixed_t hi[16][8])
+{
+  mad_fixed_t unused;
 
-  /* 19 */ lo[ 3][slot] = SHIFT(t131);
+# define IN(i)	(in[i])
+# define LO(i)	(*((i) & 1 ? &unused : &lo[i][slot]))
+# define HI(i)	(*(((i) + 1) & 1 ? &unused : &hi[i][slot]))
 
-  t140 = (t164 * 2) - t131;
+# include "dct32.dat"
 
-  /* 21 */ lo[ 5][slot] = SHIFT(t140);
+# undef IN
+# undef LO
+# undef HI
+}
 
-  t174 = (MUL(t136 - t137, costab16) * 2) - t138;
+/*
+ * NAME:	dct32_quarter()
+ * DESCRIPTION:	perform dct32() for synthesis of 1 in 4 samples or fewer
+ */
+static
+void dct32_quarter(mad_fixed_t const in[32], unsigned int slot,
+		   mad_fixed_t lo[16][8], mad_fixed_t hi[16][8])
+{
+  mad_fixed_t unused;
 
-  t155 = (t174 * 2) - t139;
+# define IN(i)	(in[i])
+# define LO(i)	(*((i) & 3 ? &unused : &lo[i][slot]))
+# define HI(i)	(*(((i) + 1) & 3 ? &unused : &hi[i][slot]))
 
-  t147 = (t155 * 2) - t140;
+# include "dct32.dat"
 
-  /* 23 */ lo[ 7][slot] = SHIFT(t147);
+# undef IN
+# undef LO
+# undef HI
+}
 
-  t156 = (((MUL(t144 - t145, costab16) * 2) - t146) * 2) - t147;
+/*
+ * Multi-stream synthesis runs NLANES channels at once, each in one lane of
+ * the structure-of-arrays buffers below. The lanes of a group share their
+ * phase, and so their window coefficients, and every inner loop runs over
+ * the lanes, which a vectorizing compiler can map onto SIMD registers.
+ *
+ * Even vectorized, gathering and scattering the filterbanks costs more than
+ * the lanes save on current x86-64, so they are only built on request
+ * (OPT_SYNTH_LANES) and when the multiply is written in C; otherwise
+ * mad_synth_frame_multi() calls mad_synth_frame() for each stream.
+ */
 
-  /* 25 */ lo[ 9][slot] = SHIFT(t156);
+# if defined(OPT_SYNTH_LANES) && (defined(FPM_DEFAULT) || defined(FPM_64BIT))
+#  define SYNTH_LANES
+# endif
 
-  t175 = (((MUL(t152 - t153, costab16) * 2) - t154) * 2) - t155;
+# if defined(SYNTH_LANES)
+# define NLANES  8
 
-  t165 = (t175 * 2) - t156;
+struct lanes {
+  mad_fixed_t in[32][NLANES];			/* subband samples [sb][l] */
+  mad_fixed_t filter[2][2][16][8][NLANES];	/* [eo][peo][s][v][l] */
+  mad_fixed_t out[32][NLANES];			/* PCM samples [i][l] */
+};
 
-  /* 27 */ lo[11][slot] = SHIFT(t165);
+/*
+ * NAME:	dct32_lanes()
+ * DESCRIPTION:	perform fast in[32]->out[32] DCT in every lane
+ */
+static
+void dct32_lanes(struct lanes *lanes, unsigned int slot, unsigned int peo)
+{
+  unsigned int l;
 
-  t176 = (((((MUL(t161 - t162, costab16) * 2) -
-	     t163) * 2) - t164) * 2) - t165;
+# define IN(i)	(lanes->in[i][l])
+# define LO(i)	(lanes->filter[0][peo][i][slot][l])
+# define HI(i)	(lanes->filter[1][peo][i][slot][l])
 
-  /* 29 */ lo[13][slot] = SHIFT(t176);
-  /* 31 */ lo[15][slot] =
-	     SHIFT((((((((MUL(t171 - t172, costab16) * 2) -
-			 t173) * 2) - t174) * 2) - t175) * 2) - t176);
+  for (l = 0; l < NLANES; ++l)
+# include "dct32.dat"
 
-  /*
-   * Totals:
-   *  80 multiplies
-   *  80 additions
-   * 119 subtractions
-   *  49 shifts (not counting SSO)
-   */
+# undef IN
+# undef LO
+# undef HI
 }
+# endif
 
 # undef MUL
 # undef SHIFT
 
+/*
+ * NAME:	square()
+ * DESCRIPTION:	return the square of a sample (at most 1) divided by 32;
+ *		this must precede the redefinition of MAD_F_SCALEBITS below
+ */
+static inline
+mad_fixed_t square(mad_fixed_t x)
+{
+  return mad_f_mul(x, x) / 32;
+}
+
 /* third SSO shift and/or D[] optimization preshift */
 
 # if defined(OPT_SSO)
@@ -548,15 +349,16 @@ mad_fixed_t const D[17][32] = {
 
 # if defined(ASO_SYNTH)
 void synth_full(struct mad_synth *, struct mad_frame const *,
-		unsigned int, unsigned int);
+		struct mad_pcm *, unsigned int, unsigned int, unsigned int);
 # else
 /*
  * NAME:	synth->full()
- * DESCRIPTION:	perform full frequency PCM synthesis
+ * DESCRIPTION:	perform full frequency PCM synthesis of ns subband samples
  */
 static
 void synth_full(struct mad_synth *synth, struct mad_frame const *frame,
-		unsigned int nch, unsigned int ns)
+		struct mad_pcm *pcm, unsigned int nch,
+		unsigned int start, unsigned int ns)
 {
   unsigned int phase, ch, s, sb, pe, po;
   mad_fixed_t *pcm1, *pcm2, (*filter)[2][2][16][8];
@@ -565,14 +367,17 @@ void synth_full(struct mad_synth *synth, struct mad_frame const *frame,
   register mad_fixed_t const (*Dptr)[32], *ptr;
   register mad_fixed64hi_t hi;
   register mad_fixed64lo_t lo;
+  STATS_LAP_DECL(lap)
+
+  STATS_LAP_START(lap, synth->stats);
 
   for (ch = 0; ch < nch; ++ch) {
     sbsample = &frame->sbsample[ch];
     filter   = &synth->filter[ch];
     phase    = synth->phase;
-    pcm1     = synth->pcm.samples[ch];
+    pcm1     = pcm->samples[ch];
 
-    for (s = 0; s < ns; ++s) {
+    for (s = start; s < start + ns; ++s) {
       dct32((*sbsample)[s], phase >> 1,
 	    (*filter)[0][phase & 1], (*filter)[1][phase & 1]);
 
@@ -684,16 +489,19 @@ void synth_full(struct mad_synth *synth, struct mad_frame const *frame,
       phase = (phase + 1) % 16;
     }
   }
+
+  STATS_LAP(lap, MAD_STAGE_SYNTH);
 }
 # endif
 
 /*
  * NAME:	synth->half()
- * DESCRIPTION:	perform half frequency PCM synthesis
+ * DESCRIPTION:	perform half frequency PCM synthesis of ns subband samples
  */
 static
 void synth_half(struct mad_synth *synth, struct mad_frame const *frame,
-		unsigned int nch, unsigned int ns)
+		struct mad_pcm *pcm, unsigned int nch,
+		unsigned int start, unsigned int ns)
 {
   unsigned int phase, ch, s, sb, pe, po;
   mad_fixed_t *pcm1, *pcm2, (*filter)[2][2][16][8];
@@ -702,14 +510,17 @@ void synth_half(struct mad_synth *synth, struct mad_frame const *frame,
   register mad_fixed_t const (*Dptr)[32], *ptr;
   register mad_fixed64hi_t hi;
   register mad_fixed64lo_t lo;
+  STATS_LAP_DECL(lap)
+
+  STATS_LAP_START(lap, synth->stats);
 
   for (ch = 0; ch < nch; ++ch) {
     sbsample = &frame->sbsample[ch];
     filter   = &synth->filter[ch];
     phase    = synth->phase;
-    pcm1     = synth->pcm.samples[ch];
+    pcm1     = pcm->samples[ch];
 
-    for (s = 0; s < ns; ++s) {
+    for (s = start; s < start + ns; ++s) {
       dct32((*sbsample)[s], phase >> 1,
 	    (*filter)[0][phase & 1], (*filter)[1][phase & 1]);
 
@@ -823,35 +634,611 @@ void synth_half(struct mad_synth *synth, struct mad_frame const *frame,
       phase = (phase + 1) % 16;
     }
   }
+
+  STATS_LAP(lap, MAD_STAGE_SYNTH);
 }
 
 /*
- * NAME:	synth->frame()
- * DESCRIPTION:	perform PCM synthesis of frame subband samples
+ * Peak synthesis computes only 1 in step of the 32 samples of each subband
+ * sample slot, like synth_half() does 1 in 2, and folds each into the
+ * extremes and mean square of the slot as soon as it is computed. Samples
+ * are clipped to full scale first, as they would be for output, so that the
+ * sum of squares (scaled as it is summed) cannot overflow.
  */
-void mad_synth_frame(struct mad_synth *synth, struct mad_frame const *frame)
+
+# define PEAK(x)  \
+    do {  \
+      sample = (x);  \
+      if (sample > MAD_F_ONE)  \
+	sample = MAD_F_ONE;  \
+      else if (sample < -MAD_F_ONE)  \
+	sample = -MAD_F_ONE;  \
+      if (sample < min)  \
+	min = sample;  \
+      if (sample > max)  \
+	max = sample;  \
+      sum += square(sample);  \
+    } while (0)
+
+/*
+ * NAME:	synth->peaks()
+ * DESCRIPTION:	perform reduced frequency synthesis of ns subband samples,
+ *		accumulating peaks instead of PCM
+ */
+static
+void synth_peaks(struct mad_synth *synth, struct mad_frame const *frame,
+		 struct mad_peaks *peaks, unsigned int nch, unsigned int ns)
 {
-  unsigned int nch, ns;
+  unsigned int phase, ch, s, sb, pe, po, mask, fill, count;
+  mad_fixed_t (*filter)[2][2][16][8];
+  mad_fixed_t const (*sbsample)[36][32];
+  register mad_fixed_t (*fe)[8], (*fx)[8], (*fo)[8];
+  register mad_fixed_t const (*Dptr)[32], *ptr;
+  register mad_fixed64hi_t hi;
+  register mad_fixed64lo_t lo;
+  mad_fixed_t sample, min, max, sum;
+  struct mad_peak *peak;
+  void (*dct)(mad_fixed_t const [32], unsigned int,
+	      mad_fixed_t [16][8], mad_fixed_t [16][8]);
+  STATS_LAP_DECL(lap)
+
+  STATS_LAP_START(lap, synth->stats);
+
+  dct   = (peaks->step == 1) ? dct32 :
+	  (peaks->step == 2) ? dct32_half : dct32_quarter;
+
+  mask  = peaks->step - 1;
+
+  fill  = peaks->fill;
+  count = peaks->count;
+
+  for (ch = 0; ch < nch; ++ch) {
+    sbsample = &frame->sbsample[ch];
+    filter   = &synth->filter[ch];
+    phase    = synth->phase;
+    peak     = &peaks->current[ch];
+
+    fill  = peaks->fill;
+    count = peaks->count;
+
+    for (s = 0; s < ns; ++s) {
+      dct((*sbsample)[s], phase >> 1,
+	  (*filter)[0][phase & 1], (*filter)[1][phase & 1]);
+
+      pe = phase & ~1;
+      po = ((phase - 1) & 0xf) | 1;
+
+      min = MAD_F_ONE;
+      max = -MAD_F_ONE;
+      sum = 0;
+
+      /* calculate 32 / step samples */
+
+      fe = &(*filter)[0][ phase & 1][0];
+      fx = &(*filter)[0][~phase & 1][0];
+      fo = &(*filter)[1][~phase & 1][0];
+
+      Dptr = &D[0];
+
+      ptr = *Dptr + po;
+      ML0(hi, lo, (*fx)[0], ptr[ 0]);
+      MLA(hi, lo, (*fx)[1], ptr[14]);
+      MLA(hi, lo, (*fx)[2], ptr[12]);
+      MLA(hi, lo, (*fx)[3], ptr[10]);
+      MLA(hi, lo, (*fx)[4], ptr[ 8]);
+      MLA(hi, lo, (*fx)[5], ptr[ 6]);
+      MLA(hi, lo, (*fx)[6], ptr[ 4]);
+      MLA(hi, lo, (*fx)[7], ptr[ 2]);
+      MLN(hi, lo);
+
+      ptr = *Dptr + pe;
+      MLA(hi, lo, (*fe)[0], ptr[ 0]);
+      MLA(hi, lo, (*fe)[1], ptr[14]);
+      MLA(hi, lo, (*fe)[2], ptr[12]);
+      MLA(hi, lo, (*fe)[3], ptr[10]);
+      MLA(hi, lo, (*fe)[4], ptr[ 8]);
+      MLA(hi, lo, (*fe)[5], ptr[ 6]);
+      MLA(hi, lo, (*fe)[6], ptr[ 4]);
+      MLA(hi, lo, (*fe)[7], ptr[ 2]);
+
+      PEAK(SHIFT(MLZ(hi, lo)));
+
+      for (sb = 1; sb < 16; ++sb) {
+	++fe;
+	++Dptr;
+
+	/* D[32 - sb][i] == -D[sb][31 - i] */
+
+	if (!(sb & mask)) {
+	  ptr = *Dptr + po;
+	  ML0(hi, lo, (*fo)[0], ptr[ 0]);
+	  MLA(hi, lo, (*fo)[1], ptr[14]);
+	  MLA(hi, lo, (*fo)[2], ptr[12]);
+	  MLA(hi, lo, (*fo)[3], ptr[10]);
+	  MLA(hi, lo, (*fo)[4], ptr[ 8]);
+	  MLA(hi, lo, (*fo)[5], ptr[ 6]);
+	  MLA(hi, lo, (*fo)[6], ptr[ 4]);
+	  MLA(hi, lo, (*fo)[7], ptr[ 2]);
+	  MLN(hi, lo);
+
+	  ptr = *Dptr + pe;
+	  MLA(hi, lo, (*fe)[7], ptr[ 2]);
+	  MLA(hi, lo, (*fe)[6], ptr[ 4]);
+	  MLA(hi, lo, (*fe)[5], ptr[ 6]);
+	  MLA(hi, lo, (*fe)[4], ptr[ 8]);
+	  MLA(hi, lo, (*fe)[3], ptr[10]);
+	  MLA(hi, lo, (*fe)[2], ptr[12]);
+	  MLA(hi, lo, (*fe)[1], ptr[14]);
+	  MLA(hi, lo, (*fe)[0], ptr[ 0]);
+
+	  PEAK(SHIFT(MLZ(hi, lo)));
+
+	  ptr = *Dptr - pe;
+	  ML0(hi, lo, (*fe)[0], ptr[31 - 16]);
+	  MLA(hi, lo, (*fe)[1], ptr[31 - 14]);
+	  MLA(hi, lo, (*fe)[2], ptr[31 - 12]);
+	  MLA(hi, lo, (*fe)[3], ptr[31 - 10]);
+	  MLA(hi, lo, (*fe)[4], ptr[31 -  8]);
+	  MLA(hi, lo, (*fe)[5], ptr[31 -  6]);
+	  MLA(hi, lo, (*fe)[6], ptr[31 -  4]);
+	  MLA(hi, lo, (*fe)[7], ptr[31 -  2]);
+
+	  ptr = *Dptr - po;
+	  MLA(hi, lo, (*fo)[7], ptr[31 -  2]);
+	  MLA(hi, lo, (*fo)[6], ptr[31 -  4]);
+	  MLA(hi, lo, (*fo)[5], ptr[31 -  6]);
+	  MLA(hi, lo, (*fo)[4], ptr[31 -  8]);
+	  MLA(hi, lo, (*fo)[3], ptr[31 - 10]);
+	  MLA(hi, lo, (*fo)[2], ptr[31 - 12]);
+	  MLA(hi, lo, (*fo)[1], ptr[31 - 14]);
+	  MLA(hi, lo, (*fo)[0], ptr[31 - 16]);
+
+	  PEAK(SHIFT(MLZ(hi, lo)));
+	}
+
+	++fo;
+      }
+
+      ++Dptr;
+
+      ptr = *Dptr + po;
+      ML0(hi, lo, (*fo)[0], ptr[ 0]);
+      MLA(hi, lo, (*fo)[1], ptr[14]);
+      MLA(hi, lo, (*fo)[2], ptr[12]);
+      MLA(hi, lo, (*fo)[3], ptr[10]);
+      MLA(hi, lo, (*fo)[4], ptr[ 8]);
+      MLA(hi, lo, (*fo)[5], ptr[ 6]);
+      MLA(hi, lo, (*fo)[6], ptr[ 4]);
+      MLA(hi, lo, (*fo)[7], ptr[ 2]);
+
+      PEAK(SHIFT(-MLZ(hi, lo)));
+
+      /* merge the slot into the current bucket (a running mean square) */
+
+      sum *= (signed int) peaks->step;
+
+      if (fill == 0) {
+	peak->min    = min;
+	peak->max    = max;
+	peak->energy = sum;
+      }
+      else {
+	if (min < peak->min)
+	  peak->min = min;
+	if (max > peak->max)
+	  peak->max = max;
+
+	peak->energy += (sum - peak->energy) / (signed int) (fill / 32 + 1);
+      }
+
+      fill += 32;
+      if (fill >= peaks->length) {
+	if (count < peaks->size)
+	  peaks->bucket[count][ch] = *peak;
+
+	++count;
+	fill = 0;
+      }
+
+      phase = (phase + 1) % 16;
+    }
+  }
+
+  STATS_LAP(lap, MAD_STAGE_SYNTH);
+
+  peaks->fill  = fill;
+  peaks->count = count;
+}
+
+# undef PEAK
+
+# if defined(SYNTH_LANES)
+/*
+ * NAME:	synth->window_lanes()
+ * DESCRIPTION:	compute 32 PCM samples in every lane
+ */
+static
+void synth_window_lanes(struct lanes *lanes, unsigned int phase)
+{
+  unsigned int sb, l, k, pe, po, e, x;
+  mad_fixed_t co[8], ce[8], mo[8], me[8];
+  mad_fixed64hi_t hi;
+  mad_fixed64lo_t lo;
+
+  pe = phase & ~1;
+  po = ((phase - 1) & 0xf) | 1;
+
+  e =  phase & 1;
+  x = ~phase & 1;
+
+  /*
+   * These are the operations of synth_full(), in the same order. The window
+   * coefficients of each sample are loaded before the loop over the lanes,
+   * since they are the same in every lane.
+   */
+
+# define FE(sb, v)  (lanes->filter[0][e][sb][v][l])
+# define FX(sb, v)  (lanes->filter[0][x][sb][v][l])
+# define FO(sb, v)  (lanes->filter[1][x][sb][v][l])
+
+  for (k = 0; k < 8; ++k) {
+    co[k] = D[0][po + ((16 - 2 * k) & 15)];
+    ce[k] = D[0][pe + ((16 - 2 * k) & 15)];
+  }
+
+  for (l = 0; l < NLANES; ++l) {
+    ML0(hi, lo, FX(0, 0), co[0]);
+    MLA(hi, lo, FX(0, 1), co[1]);
+    MLA(hi, lo, FX(0, 2), co[2]);
+    MLA(hi, lo, FX(0, 3), co[3]);
+    MLA(hi, lo, FX(0, 4), co[4]);
+    MLA(hi, lo, FX(0, 5), co[5]);
+    MLA(hi, lo, FX(0, 6), co[6]);
+    MLA(hi, lo, FX(0, 7), co[7]);
+    MLN(hi, lo);
+
+    MLA(hi, lo, FE(0, 0), ce[0]);
+    MLA(hi, lo, FE(0, 1), ce[1]);
+    MLA(hi, lo, FE(0, 2), ce[2]);
+    MLA(hi, lo, FE(0, 3), ce[3]);
+    MLA(hi, lo, FE(0, 4), ce[4]);
+    MLA(hi, lo, FE(0, 5), ce[5]);
+    MLA(hi, lo, FE(0, 6), ce[6]);
+    MLA(hi, lo, FE(0, 7), ce[7]);
+
+    lanes->out[0][l] = SHIFT(MLZ(hi, lo));
+  }
+
+  for (sb = 1; sb < 16; ++sb) {
+    for (k = 0; k < 8; ++k) {
+      co[k] = D[sb][po + ((16 - 2 * k) & 15)];
+      ce[k] = D[sb][pe + ((16 - 2 * k) & 15)];
+    }
+
+    for (l = 0; l < NLANES; ++l) {
+      ML0(hi, lo, FO(sb - 1, 0), co[0]);
+      MLA(hi, lo, FO(sb - 1, 1), co[1]);
+      MLA(hi, lo, FO(sb - 1, 2), co[2]);
+      MLA(hi, lo, FO(sb - 1, 3), co[3]);
+      MLA(hi, lo, FO(sb - 1, 4), co[4]);
+      MLA(hi, lo, FO(sb - 1, 5), co[5]);
+      MLA(hi, lo, FO(sb - 1, 6), co[6]);
+      MLA(hi, lo, FO(sb - 1, 7), co[7]);
+      MLN(hi, lo);
+
+      MLA(hi, lo, FE(sb, 7), ce[7]);
+      MLA(hi, lo, FE(sb, 6), ce[6]);
+      MLA(hi, lo, FE(sb, 5), ce[5]);
+      MLA(hi, lo, FE(sb, 4), ce[4]);
+      MLA(hi, lo, FE(sb, 3), ce[3]);
+      MLA(hi, lo, FE(sb, 2), ce[2]);
+      MLA(hi, lo, FE(sb, 1), ce[1]);
+      MLA(hi, lo, FE(sb, 0), ce[0]);
+
+      lanes->out[sb][l] = SHIFT(MLZ(hi, lo));
+    }
+
+    /* D[32 - sb][i] == -D[sb][31 - i] */
+
+    for (k = 0; k < 8; ++k) {
+      mo[k] = D[sb][15 + 2 * k - po];
+      me[k] = D[sb][15 + 2 * k - pe];
+    }
+
+    for (l = 0; l < NLANES; ++l) {
+      ML0(hi, lo, FE(sb, 0), me[0]);
+      MLA(hi, lo, FE(sb, 1), me[1]);
+      MLA(hi, lo, FE(sb, 2), me[2]);
+      MLA(hi, lo, FE(sb, 3), me[3]);
+      MLA(hi, lo, FE(sb, 4), me[4]);
+      MLA(hi, lo, FE(sb, 5), me[5]);
+      MLA(hi, lo, FE(sb, 6), me[6]);
+      MLA(hi, lo, FE(sb, 7), me[7]);
+
+      MLA(hi, lo, FO(sb - 1, 7), mo[7]);
+      MLA(hi, lo, FO(sb - 1, 6), mo[6]);
+      MLA(hi, lo, FO(sb - 1, 5), mo[5]);
+      MLA(hi, lo, FO(sb - 1, 4), mo[4]);
+      MLA(hi, lo, FO(sb - 1, 3), mo[3]);
+      MLA(hi, lo, FO(sb - 1, 2), mo[2]);
+      MLA(hi, lo, FO(sb - 1, 1), mo[1]);
+      MLA(hi, lo, FO(sb - 1, 0), mo[0]);
+
+      lanes->out[32 - sb][l] = SHIFT(MLZ(hi, lo));
+    }
+  }
+
+  for (k = 0; k < 8; ++k)
+    co[k] = D[16][po + ((16 - 2 * k) & 15)];
+
+  for (l = 0; l < NLANES; ++l) {
+    ML0(hi, lo, FO(15, 0), co[0]);
+    MLA(hi, lo, FO(15, 1), co[1]);
+    MLA(hi, lo, FO(15, 2), co[2]);
+    MLA(hi, lo, FO(15, 3), co[3]);
+    MLA(hi, lo, FO(15, 4), co[4]);
+    MLA(hi, lo, FO(15, 5), co[5]);
+    MLA(hi, lo, FO(15, 6), co[6]);
+    MLA(hi, lo, FO(15, 7), co[7]);
+
+    lanes->out[16][l] = SHIFT(-MLZ(hi, lo));
+  }
+
+# undef FE
+# undef FX
+# undef FO
+}
+
+/* one lane of multi-stream synthesis */
+struct lane {
+  struct mad_synth *synth;
+  unsigned int ch;
+  mad_fixed_t const (*sbsample)[36][32];
+};
+
+/*
+ * NAME:	synth->lanes()
+ * DESCRIPTION:	perform full frequency PCM synthesis of ns subband samples
+ *		for a group of lanes sharing the same phase
+ */
+static
+void synth_lanes(struct lanes *lanes, struct lane const *lane,
+		 unsigned int n, unsigned int phase, unsigned int ns)
+{
+  unsigned int l, s, sb, eo, peo, v;
+  mad_fixed_t *pcm;
+
+  /* gather each channel's filterbank; unused lanes stay zero throughout */
+
+  for (eo = 0; eo < 2; ++eo) {
+    for (peo = 0; peo < 2; ++peo) {
+      for (sb = 0; sb < 16; ++sb) {
+	for (v = 0; v < 8; ++v) {
+	  for (l = 0; l < NLANES; ++l) {
+	    lanes->filter[eo][peo][sb][v][l] = (l < n) ?
+	      lane[l].synth->filter[lane[l].ch][eo][peo][sb][v] : 0;
+	  }
+	}
+      }
+    }
+  }
+
+  for (sb = 0; sb < 32; ++sb) {
+    for (l = n; l < NLANES; ++l)
+      lanes->in[sb][l] = 0;
+  }
+
+  for (s = 0; s < ns; ++s) {
+    for (l = 0; l < n; ++l) {
+      for (sb = 0; sb < 32; ++sb)
+	lanes->in[sb][l] = (*lane[l].sbsample)[s][sb];
+    }
+
+    dct32_lanes(lanes, phase >> 1, phase & 1);
+    synth_window_lanes(lanes, phase);
+
+    for (l = 0; l < n; ++l) {
+      pcm = &lane[l].synth->pcm.samples[lane[l].ch][32 * s];
+
+      for (sb = 0; sb < 32; ++sb)
+	pcm[sb] = lanes->out[sb][l];
+    }
+
+    phase = (phase + 1) % 16;
+  }
+
+  for (eo = 0; eo < 2; ++eo) {
+    for (peo = 0; peo < 2; ++peo) {
+      for (sb = 0; sb < 16; ++sb) {
+	for (v = 0; v < 8; ++v) {
+	  for (l = 0; l < n; ++l) {
+	    lane[l].synth->filter[lane[l].ch][eo][peo][sb][v] =
+	      lanes->filter[eo][peo][sb][v][l];
+	  }
+	}
+      }
+    }
+  }
+}
+# endif
+
+/*
+ * NAME:	synth->range()
+ * DESCRIPTION:	perform PCM synthesis of ns subband samples from start
+ */
+static
+void synth_range(struct mad_synth *synth, struct mad_frame const *frame,
+		 struct mad_pcm *pcm, unsigned int start, unsigned int ns)
+{
+  unsigned int nch;
   void (*synth_frame)(struct mad_synth *, struct mad_frame const *,
+		      struct mad_pcm *, unsigned int,
 		      unsigned int, unsigned int);
 
   nch = MAD_NCHANNELS(&frame->header);
-  ns  = MAD_NSBSAMPLES(&frame->header);
 
-  synth->pcm.samplerate = frame->header.samplerate;
-  synth->pcm.channels   = nch;
-  synth->pcm.length     = 32 * ns;
+  pcm->samplerate = frame->header.samplerate;
+  pcm->channels   = nch;
+  pcm->length     = 32 * ns;
 
   synth_frame = synth_full;
 
   if (frame->options & MAD_OPTION_HALFSAMPLERATE) {
-    synth->pcm.samplerate /= 2;
-    synth->pcm.length     /= 2;
+    pcm->samplerate /= 2;
+    pcm->length     /= 2;
 
     synth_frame = synth_half;
   }
 
-  synth_frame(synth, frame, nch, ns);
+  synth_frame(synth, frame, pcm, nch, start, ns);
+
+  synth->phase = (synth->phase + ns) % 16;
+}
+
+/*
+ * NAME:	synth->frame()
+ * DESCRIPTION:	perform PCM synthesis of frame subband samples
+ */
+void mad_synth_frame(struct mad_synth *synth, struct mad_frame const *frame)
+{
+  synth_range(synth, frame, &synth->pcm, 0, MAD_NSBSAMPLES(&frame->header));
+}
+
+/*
+ * NAME:	synth->frames()
+ * DESCRIPTION:	perform PCM synthesis of consecutive frames, each into its
+ *		own PCM buffer (synth->pcm is left alone)
+ */
+void mad_synth_frames(struct mad_synth *synth, struct mad_frame const *frames,
+		      unsigned int count, struct mad_pcm *pcm)
+{
+  unsigned int i;
+
+  for (i = 0; i < count; ++i) {
+    synth_range(synth, &frames[i], &pcm[i],
+		0, MAD_NSBSAMPLES(&frames[i].header));
+  }
+}
+
+/*
+ * NAME:	synth->granule()
+ * DESCRIPTION:	perform PCM synthesis of the subband samples of one Layer III
+ *		granule (576 samples, or 288 at half sample rate)
+ */
+void mad_synth_granule(struct mad_synth *synth, struct mad_frame const *frame,
+		       unsigned int gr)
+{
+  synth_range(synth, frame, &synth->pcm, 18 * gr, 18);
+}
+
+/*
+ * NAME:	synth->frame_multi()
+ * DESCRIPTION:	perform PCM synthesis of the subband samples of count
+ *		independent streams, frame[i] into synth[i]->pcm
+ */
+void mad_synth_frame_multi(struct mad_synth *synth[],
+			   struct mad_frame const *frame[], unsigned int count)
+{
+# if !defined(SYNTH_LANES)
+  unsigned int i;
+
+  for (i = 0; i < count; ++i)
+    mad_synth_frame(synth[i], frame[i]);
+# else
+  static unsigned int const nsbsamples[3] = { 12, 18, 36 };
+  struct lanes lanes;
+  struct lane lane[NLANES];
+  unsigned int i, k, ch, nch, ns, phase, n;
+
+  /*
+   * Channels are grouped by their number of subband samples and starting
+   * phase, so that all lanes of a group use the same window coefficients.
+   * Streams at half sample rate are synthesized on their own.
+   */
+
+  for (k = 0; k < 3 * 16; ++k) {
+    ns    = nsbsamples[k / 16];
+    phase = k % 16;
+    n     = 0;
+
+    for (i = 0; i < count; ++i) {
+      if ((frame[i]->options & MAD_OPTION_HALFSAMPLERATE) ||
+	  MAD_NSBSAMPLES(&frame[i]->header) != ns ||
+	  synth[i]->phase != phase)
+	continue;
+
+      nch = MAD_NCHANNELS(&frame[i]->header);
+
+      for (ch = 0; ch < nch; ++ch) {
+	lane[n].synth    = synth[i];
+	lane[n].ch       = ch;
+	lane[n].sbsample = &frame[i]->sbsample[ch];
+
+	if (++n == NLANES) {
+	  synth_lanes(&lanes, lane, n, phase, ns);
+	  n = 0;
+	}
+      }
+    }
+
+    if (n)
+      synth_lanes(&lanes, lane, n, phase, ns);
+  }
+
+  for (i = 0; i < count; ++i) {
+    struct mad_pcm *pcm = &synth[i]->pcm;
+
+    if (frame[i]->options & MAD_OPTION_HALFSAMPLERATE) {
+      mad_synth_frame(synth[i], frame[i]);
+      continue;
+    }
+
+    ns = MAD_NSBSAMPLES(&frame[i]->header);
+
+    pcm->samplerate = frame[i]->header.samplerate;
+    pcm->channels   = MAD_NCHANNELS(&frame[i]->header);
+    pcm->length     = 32 * ns;
+
+    synth[i]->phase = (synth[i]->phase + ns) % 16;
+  }
+# endif
+}
+
+/*
+ * NAME:	peaks->init()
+ * DESCRIPTION:	initialize peaks struct for buckets of length samples (a
+ *		multiple of 32), synthesizing 1 in step (1, 2, 4, 8, or 16)
+ */
+void mad_peaks_init(struct mad_peaks *peaks, unsigned int length,
+		    unsigned int step, struct mad_peak (*bucket)[2],
+		    unsigned int size)
+{
+  if (step == 0 || step > 16 || (step & (step - 1)))
+    step = 1;
+
+  peaks->length = length;
+  peaks->step   = step;
+
+  peaks->bucket = bucket;
+  peaks->size   = size;
+  peaks->count  = 0;
+
+  peaks->fill   = 0;
+}
+
+/*
+ * NAME:	synth->peaks()
+ * DESCRIPTION:	perform reduced rate synthesis of frame subband samples into
+ *		peak buckets (synth->pcm is left alone)
+ */
+void mad_synth_peaks(struct mad_synth *synth, struct mad_frame const *frame,
+		     struct mad_peaks *peaks)
+{
+  unsigned int ns;
+
+  ns = MAD_NSBSAMPLES(&frame->header);
+
+  synth_peaks(synth, frame, peaks, MAD_NCHANNELS(&frame->header), ns);
 
   synth->phase = (synth->phase + ns) % 16;
 }
@@ -32,6 +32,8 @@ struct mad_pcm {
   mad_fixed_t samples[2][1152];		/* PCM output samples [ch][sample] */
 };
 
+struct mad_stats;
+
 struct mad_synth {
   mad_fixed_t filter[2][2][2][16][8];	/* polyphase filterbank outputs */
   					/* [ch][eo][peo][s][v] */
@@ -39,6 +41,26 @@ struct mad_synth {
   unsigned int phase;			/* current processing phase */
 
   struct mad_pcm pcm;			/* PCM output */
+
+  struct mad_stats *stats;		/* stage timing (0 = none) */
+};
+
+struct mad_peak {
+  mad_fixed_t min;			/* lowest sample */
+  mad_fixed_t max;			/* highest sample */
+  mad_fixed_t energy;			/* mean square */
+};
+
+struct mad_peaks {
+  unsigned int length;			/* samples per bucket */
+  unsigned int step;			/* synthesize 1 in step samples */
+
+  struct mad_peak (*bucket)[2];		/* complete buckets [n][ch] */
+  unsigned int size;			/* number of buckets allocated */
+  unsigned int count;			/* number of buckets completed */
+
+  unsigned int fill;			/* samples in the current bucket */
+  struct mad_peak current[2];		/* bucket being accumulated [ch] */
 };
 
 /* single channel PCM selector */
@@ -65,5 +87,16 @@ void mad_synth_init(struct mad_synth *);
 void mad_synth_mute(struct mad_synth *);
 
 void mad_synth_frame(struct mad_synth *, struct mad_frame const *);
+void mad_synth_frames(struct mad_synth *, struct mad_frame const *,
+		      unsigned int, struct mad_pcm *);
+void mad_synth_granule(struct mad_synth *, struct mad_frame const *,
+		       unsigned int);
+void mad_synth_frame_multi(struct mad_synth *[],
+			   struct mad_frame const *[], unsigned int);
+
+void mad_peaks_init(struct mad_peaks *, unsigned int, unsigned int,
+		    struct mad_peak (*)[2], unsigned int);
+void mad_synth_peaks(struct mad_synth *, struct mad_frame const *,
+		     struct mad_peaks *);
 
 # endif
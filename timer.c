@@ -263,6 +263,33 @@ void mad_timer_multiply(mad_timer_t *timer, signed long scalar)
   }
 }
 
+/*
+ * NAME:	timer->samples()
+ * DESCRIPTION:	set timer from a sample count at the given sample rate
+ */
+void mad_timer_samples(mad_timer_t *timer, mad_samples_t samples,
+		       unsigned long samplerate)
+{
+  unsigned long remainder;
+
+  if (samplerate == 0) {
+    *timer = mad_timer_zero;
+    return;
+  }
+
+  remainder = (unsigned long) (samples % samplerate);
+
+  /* every MPEG sample rate divides the timer resolution exactly */
+
+  if (MAD_TIMER_RESOLUTION % samplerate == 0) {
+    timer->seconds  = (signed long) (samples / samplerate);
+    timer->fraction = remainder * (MAD_TIMER_RESOLUTION / samplerate);
+  }
+  else
+    mad_timer_set(timer, (unsigned long) (samples / samplerate),
+		  remainder, samplerate);
+}
+
 /*
  * NAME:	timer->count()
  * DESCRIPTION:	return timer value in selected units
@@ -29,6 +29,15 @@ typedef struct {
 
 extern mad_timer_t const mad_timer_zero;
 
+# if defined(_MSC_VER)
+typedef unsigned __int64 mad_samples_t;
+# elif defined(__GNUC__) ||  \
+      (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L)
+typedef unsigned long long mad_samples_t;
+# else
+typedef unsigned long mad_samples_t;
+# endif
+
 # define MAD_TIMER_RESOLUTION	352800000UL
 
 enum mad_units {
@@ -91,6 +100,7 @@ mad_timer_t mad_timer_abs(mad_timer_t);
 void mad_timer_set(mad_timer_t *, unsigned long, unsigned long, unsigned long);
 void mad_timer_add(mad_timer_t *, mad_timer_t);
 void mad_timer_multiply(mad_timer_t *, signed long);
+void mad_timer_samples(mad_timer_t *, mad_samples_t, unsigned long);
 
 signed long mad_timer_count(mad_timer_t, enum mad_units);
 unsigned long mad_timer_fraction(mad_timer_t, unsigned long);
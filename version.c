@@ -42,7 +42,9 @@ char const mad_build[] = ""
   "EXPERIMENTAL "
 # endif
 
-# if defined(FPM_64BIT)
+# if defined(FPM_FLOAT)
+  "FPM_FLOAT "
+# elif defined(FPM_64BIT)
   "FPM_64BIT "
 # elif defined(FPM_INTEL)
   "FPM_INTEL "
@@ -81,6 +83,10 @@ char const mad_build[] = ""
   "OPT_SSO "
 # endif
 
+# if defined(OPT_COMPACT_RQ)
+  "OPT_COMPACT_RQ "
+# endif
+
 # if defined(OPT_DCTO)  /* never defined here */
   "OPT_DCTO "
 # endif